@@ -0,0 +1,166 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include "BookFile.h"
+
+using namespace book_file;
+
+static std::uint64_t align8(std::uint64_t offset) { return (offset + 7) & ~std::uint64_t(7); }
+
+// appends bytes to the image at an aligned offset and returns that offset
+static std::uint64_t appendSection(std::vector<char>& image, const void* data, std::size_t size)
+{
+  image.resize(align8(image.size()));
+  std::uint64_t offset = image.size();
+  image.insert(image.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+  return offset;
+}
+
+static StringTable appendStrings(std::vector<char>& image, const std::vector<std::string_view>& names)
+{
+  std::vector<std::uint32_t> offsets;
+  offsets.reserve(names.size() + 1);
+  std::uint64_t chars = 0;
+  for(std::string_view name: names)
+  {
+    offsets.push_back(static_cast<std::uint32_t>(chars));
+    chars += name.size();
+  }
+  if(chars > std::numeric_limits<std::uint32_t>::max())
+    throw std::runtime_error("Error: book file string table is too large!");
+  offsets.push_back(static_cast<std::uint32_t>(chars));
+
+  StringTable table;
+  table.count = names.size();
+  table.offsets = appendSection(image, offsets.data(), offsets.size() * sizeof(std::uint32_t));
+  image.resize(align8(image.size()));
+  table.chars = image.size();
+  for(std::string_view name: names)
+    image.insert(image.end(), name.begin(), name.end());
+  return table;
+}
+
+void writeBookFile(const std::string& path, const BookContents& contents)
+{
+  BookHeader header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.byteOrder = BYTE_ORDER_MARK;
+
+  std::vector<char> image(sizeof(BookHeader));
+  header.securities = appendStrings(image, contents.securities);
+  header.users = appendStrings(image, contents.users);
+  header.companies = appendStrings(image, contents.companies);
+  header.orderIds = appendStrings(image, contents.orderIds);
+  header.records = appendSection(image, contents.records.data(), contents.records.size() * sizeof(BookRecord));
+  header.securityRuns = appendSection(image, contents.securityRuns.data()
+    , contents.securityRuns.size() * sizeof(BookSecurity));
+
+  // at most half full, so probes stay short and always reach an empty slot
+  std::uint64_t hashSize = 2;
+  while(hashSize < contents.securities.size() * 2)
+    hashSize *= 2;
+  std::vector<std::uint32_t> slots(hashSize, EMPTY_SLOT);
+  for(std::size_t i = 0; i < contents.securities.size(); i++)
+  {
+    std::uint64_t slot = hashName(contents.securities[i]) & (hashSize - 1);
+    while(slots[slot] != EMPTY_SLOT)
+      slot = (slot + 1) & (hashSize - 1);
+    slots[slot] = static_cast<std::uint32_t>(i);
+  }
+  header.securityHash = appendSection(image, slots.data(), slots.size() * sizeof(std::uint32_t));
+  header.securityHashSize = hashSize;
+  header.fileSize = image.size();
+  std::memcpy(image.data(), &header, sizeof(header));
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(image.data(), static_cast<std::streamsize>(image.size()));
+  if(!file.flush())
+    throw std::runtime_error("Error: cannot write book file!");
+}
+
+MappedBook::MappedBook(const std::string& path)
+    : m_file(path)
+    , m_data(m_file.data())
+    , m_size(m_file.size())
+{
+  check();
+}
+
+std::uint32_t MappedBook::findSecurity(std::string_view securityId) const
+{
+  std::uint64_t mask = m_header->securityHashSize - 1;
+  for(std::uint64_t slot = hashName(securityId) & mask; ; slot = (slot + 1) & mask)
+  {
+    std::uint32_t index = m_hash[slot];
+    if(index == EMPTY_SLOT || security(index) == securityId)
+      return index;
+  }
+}
+
+////------------------------  PRIVATE -------------------------------------------
+
+void MappedBook::check()
+{
+  auto invalid = []() { throw std::runtime_error("Error: invalid book file!"); };
+  // true when count items of itemSize fit at the aligned offset
+  auto fits = [this](std::uint64_t offset, std::uint64_t count, std::uint64_t itemSize)
+  {
+    return offset % 8 == 0 && offset <= m_size && count <= (m_size - offset) / itemSize;
+  };
+
+  if(m_size < sizeof(BookHeader))
+    invalid();
+  m_header = reinterpret_cast<const BookHeader*>(m_data);
+  const BookHeader& header = *m_header;
+  if(std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.byteOrder != BYTE_ORDER_MARK)
+    invalid();
+  if(header.version != VERSION)
+    throw std::runtime_error("Error: unsupported book file version!");
+  if(header.fileSize != m_size)
+    invalid();
+
+  for(const StringTable* table: { &header.securities, &header.users, &header.companies, &header.orderIds })
+  {
+    if(table->count >= EMPTY_SLOT || !fits(table->offsets, table->count + 1, sizeof(std::uint32_t)))
+      invalid();
+    const std::uint32_t* offsets = reinterpret_cast<const std::uint32_t*>(m_data + table->offsets);
+    for(std::uint64_t i = 0; i < table->count; i++)
+    {
+      if(offsets[i] > offsets[i + 1])
+        invalid();
+    }
+    if(!fits(table->chars, offsets[table->count], 1))
+      invalid();
+  }
+
+  if(!fits(header.records, header.orderIds.count, sizeof(BookRecord))
+    || !fits(header.securityRuns, header.securities.count, sizeof(BookSecurity))
+    || !fits(header.securityHash, header.securityHashSize, sizeof(std::uint32_t))
+    || header.securityHashSize <= header.securities.count
+    || (header.securityHashSize & (header.securityHashSize - 1)))
+    invalid();
+  m_records = reinterpret_cast<const BookRecord*>(m_data + header.records);
+  m_runs = reinterpret_cast<const BookSecurity*>(m_data + header.securityRuns);
+  m_hash = reinterpret_cast<const std::uint32_t*>(m_data + header.securityHash);
+
+  for(std::uint64_t i = 0; i < header.orderIds.count; i++)
+  {
+    if(m_records[i].user >= header.users.count || m_records[i].company >= header.companies.count || !m_records[i].qty)
+      invalid();
+  }
+  for(std::uint64_t i = 0; i < header.securities.count; i++)
+  {
+    const BookSecurity& run = m_runs[i];
+    if(run.firstRecord > header.orderIds.count
+      || std::uint64_t(run.buyCount) + run.sellCount > header.orderIds.count - run.firstRecord)
+      invalid();
+  }
+  for(std::uint64_t slot = 0; slot < header.securityHashSize; slot++)
+  {
+    if(m_hash[slot] != EMPTY_SLOT && m_hash[slot] >= header.securities.count)
+      invalid();
+  }
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MappedFile.h"
+
+// On-disk layout of a saved order book, made to be mapped and read in place.
+// All sections start at 8-byte aligned offsets from the start of the file
+// and use the byte order of the machine that wrote them, which the header
+// records. Orders are grouped by security, buys before sells, so the orders
+// of a security are one run of records and the order id strings are stored
+// in record order.
+//
+//   BookHeader
+//   string tables: securities, users, companies, order ids
+//     each is count + 1 uint32 offsets followed by the characters
+//   BookRecord[orderCount]
+//   BookSecurity[securityCount]       runs of records and matching sizes
+//   uint32[securityHashSize]          open addressing table of securities
+namespace book_file
+{
+  constexpr char MAGIC[8] = { 'O', 'C', 'B', 'O', 'O', 'K', '\0', '\0' };
+  constexpr std::uint32_t VERSION = 1;
+  constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+  constexpr std::uint32_t EMPTY_SLOT = ~std::uint32_t(0);
+
+  struct StringTable
+  {
+    std::uint64_t offsets;  // file offset of count + 1 uint32 offsets into chars
+    std::uint64_t chars;    // file offset of the characters
+    std::uint64_t count;
+  };
+
+  struct BookHeader
+  {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint64_t fileSize;
+    StringTable securities;
+    StringTable users;
+    StringTable companies;
+    StringTable orderIds;
+    std::uint64_t records;         // file offset of orderIds.count BookRecords
+    std::uint64_t securityRuns;    // file offset of securities.count BookSecurity
+    std::uint64_t securityHash;    // file offset of securityHashSize uint32 slots
+    std::uint64_t securityHashSize;
+  };
+
+  // one order; its security and side follow from the run it is in
+  struct BookRecord
+  {
+    std::uint32_t user;
+    std::uint32_t company;
+    std::uint32_t qty;
+  };
+
+  struct BookSecurity
+  {
+    std::uint64_t firstRecord;
+    std::uint32_t buyCount;
+    std::uint32_t sellCount;
+    std::uint32_t matchingSize;
+    std::uint32_t reserved;
+  };
+
+  // FNV-1a, fixed so that files stay valid across builds
+  inline std::uint64_t hashName(std::string_view name)
+  {
+    std::uint64_t hash = 14695981039346656037ull;
+    for(char c: name)
+    {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+}
+
+// everything a book file holds, filled by the cache and written in one go;
+// throws std::runtime_error when the file cannot be written
+struct BookContents
+{
+  std::vector<std::string_view> securities;
+  std::vector<std::string_view> users;
+  std::vector<std::string_view> companies;
+  std::vector<std::string_view> orderIds;  // in record order
+  std::vector<book_file::BookRecord> records;
+  std::vector<book_file::BookSecurity> securityRuns;
+};
+
+void writeBookFile(const std::string& path, const BookContents& contents);
+
+// Read-only view of a book file, see MappedFile. The constructor checks the header and that
+// every section lies inside the file, and throws std::runtime_error if not.
+class MappedBook
+{
+ public:
+  explicit MappedBook(const std::string& path);
+
+  MappedBook(const MappedBook&) = delete;
+  MappedBook& operator=(const MappedBook&) = delete;
+
+  std::size_t securityCount() const { return m_header->securities.count; }
+  std::size_t userCount() const     { return m_header->users.count; }
+  std::size_t companyCount() const  { return m_header->companies.count; }
+  std::size_t orderCount() const    { return m_header->orderIds.count; }
+
+  std::string_view security(std::size_t index) const { return name(m_header->securities, index); }
+  std::string_view user(std::size_t index) const     { return name(m_header->users, index); }
+  std::string_view company(std::size_t index) const  { return name(m_header->companies, index); }
+  std::string_view orderId(std::size_t index) const  { return name(m_header->orderIds, index); }
+
+  const book_file::BookRecord& record(std::size_t index) const { return m_records[index]; }
+  const book_file::BookSecurity& securityRun(std::size_t index) const { return m_runs[index]; }
+
+  // index of the security or book_file::EMPTY_SLOT
+  std::uint32_t findSecurity(std::string_view securityId) const;
+
+ private:
+   MappedFile m_file;
+   const char* m_data = nullptr;
+   std::size_t m_size = 0;
+   const book_file::BookHeader* m_header = nullptr;
+   const book_file::BookRecord* m_records = nullptr;
+   const book_file::BookSecurity* m_runs = nullptr;
+   const std::uint32_t* m_hash = nullptr;
+
+   std::string_view name(const book_file::StringTable& table, std::size_t index) const
+   {
+     const std::uint32_t* offsets = reinterpret_cast<const std::uint32_t*>(m_data + table.offsets);
+     return std::string_view(m_data + table.chars + offsets[index], offsets[index + 1] - offsets[index]);
+   }
+
+   void check();
+};
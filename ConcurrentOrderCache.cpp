@@ -0,0 +1,238 @@
+#include <functional>
+#include <stdexcept>
+#include "ConcurrentOrderCache.h"
+
+ConcurrentOrderCache::ConcurrentOrderCache(std::size_t shards)
+{
+  if(!shards)
+    shards = 1;
+  for(std::size_t i = 0; i < shards; i++)
+  {
+    m_shards.push_back(std::make_unique<Shard>());
+    m_stripes.push_back(std::make_unique<IdStripe>());
+  }
+}
+
+void ConcurrentOrderCache::addOrder(Order order) {
+  OrderError error = OrderCache::validate(order);
+  if(error != OrderError::None)
+    OrderCache::throwError(error);
+
+  std::size_t shard = shardIndex(order.m_securityId);
+  IdStripe& stripe = stripeOf(order.m_orderId);
+  {
+    // the id is claimed first, so a concurrent add of the same id fails here
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    if(!stripe.shardOf.emplace(order.m_orderId, shard).second)
+      OrderCache::throwError(OrderError::DuplicateOrderId);
+  }
+
+  // the shard adds from views of the fields, so the order stays intact for
+  // the rollback without a copy of its id
+  try
+  {
+    std::unique_lock<std::shared_mutex> lock(m_shards[shard]->mutex);
+    m_shards[shard]->cache.emplaceOrder(order.m_orderId, order.m_securityId, order.m_side, order.m_qty, order.m_user
+      , order.m_company);
+  }
+  catch(...)
+  {
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    stripe.shardOf.erase(order.m_orderId);
+    throw;
+  }
+}
+
+void ConcurrentOrderCache::cancelOrder(const std::string& orderId) {
+  if(orderId.empty())
+    throw std::invalid_argument("Error: order ID is empty!");
+
+  IdStripe& stripe = stripeOf(orderId);
+  std::size_t shard;
+  {
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto it = stripe.shardOf.find(orderId);
+    if(it == stripe.shardOf.end())
+      return;
+    shard = it->second;
+  }
+
+  // the order may be cancelled by another thread or still be on its way in
+  // since the lookup, so the shard is checked again under its lock
+  std::unique_lock<std::shared_mutex> lock(m_shards[shard]->mutex);
+  OrderCache& cache = m_shards[shard]->cache;
+  if(!cache.contains(orderId))
+    return;
+  cache.cancelOrder(orderId);
+
+  std::lock_guard<std::mutex> stripeLock(stripe.mutex);
+  stripe.shardOf.erase(orderId);
+}
+
+void ConcurrentOrderCache::cancelOrdersForUser(const std::string& user) {
+  if(user.empty())
+    throw std::invalid_argument("Error: user is empty!");
+
+  std::vector<std::unique_lock<std::shared_mutex>> locks;
+  locks.reserve(m_shards.size());
+  for(auto& shard: m_shards)
+    locks.emplace_back(shard->mutex);
+
+  std::vector<std::string> ids;
+  for(auto& shard: m_shards)
+  {
+    shard->cache.collectUserOrderIds(user, ids);
+    shard->cache.cancelOrdersForUser(user);
+  }
+  eraseIds(ids);
+}
+
+void ConcurrentOrderCache::cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty) {
+  if(securityId.empty())
+    throw std::invalid_argument("Error: security ID is empty!");
+  if(!minQty)
+    throw std::invalid_argument("Error: minQty is zero!");
+
+  Shard& shard = *m_shards[shardIndex(securityId)];
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  std::vector<std::string> ids;
+  shard.cache.collectMinimumQtyOrderIds(securityId, minQty, ids);
+  shard.cache.cancelOrdersForSecIdWithMinimumQty(securityId, minQty);
+  eraseIds(ids);
+}
+
+unsigned int ConcurrentOrderCache::getMatchingSizeForSecurity(const std::string& securityId) {
+  if(securityId.empty())
+    throw std::invalid_argument("Error: security ID is empty!");
+
+  Shard& shard = *m_shards[shardIndex(securityId)];
+  {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    unsigned int size;
+    if(shard.cache.cachedMatchingSize(securityId, size))
+      return size;
+  }
+
+  // computing the size caches it in the shard, which needs the write lock
+  std::unique_lock<std::shared_mutex> lock(shard.mutex);
+  return shard.cache.getMatchingSizeForSecurity(securityId);
+}
+
+std::vector<Order> ConcurrentOrderCache::getAllOrders() const {
+  std::vector<std::shared_lock<std::shared_mutex>> locks;
+  locks.reserve(m_shards.size());
+  std::size_t count = 0;
+  for(auto& shard: m_shards)
+  {
+    locks.emplace_back(shard->mutex);
+    count += shard->cache.orderCount();
+  }
+
+  std::vector<Order> orders;
+  orders.reserve(count);
+  for(auto& shard: m_shards)
+  {
+    shard->cache.forEachOrder([&orders](const OrderView& order) {
+      orders.push_back(OrderCache::makeOrder(order));
+    });
+  }
+  return orders;
+}
+
+// the shards never hold a loaded book, so the exposure queries only read
+// their totals and may run under a read lock
+CompanyExposure ConcurrentOrderCache::getCompanyExposure(const std::string& securityId, const std::string& company) {
+  if(securityId.empty())
+    throw std::invalid_argument("Error: security ID is empty!");
+
+  Shard& shard = *m_shards[shardIndex(securityId)];
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  return shard.cache.getCompanyExposure(securityId, company);
+}
+
+CompanyExposure ConcurrentOrderCache::getCompanyExposure(const std::string& company) {
+  if(company.empty())
+    throw std::invalid_argument("Error: company name is empty!");
+
+  std::vector<std::shared_lock<std::shared_mutex>> locks;
+  locks.reserve(m_shards.size());
+  for(auto& shard: m_shards)
+    locks.emplace_back(shard->mutex);
+
+  CompanyExposure result{ {}, 0, 0 };
+  for(auto& shard: m_shards)
+  {
+    CompanyExposure part = shard->cache.getCompanyExposure(company);
+    if(result.company.empty())
+      result.company = part.company;
+    result.buyQty += part.buyQty;
+    result.sellQty += part.sellQty;
+  }
+  return result;
+}
+
+std::vector<CompanyExposure> ConcurrentOrderCache::getCompanyExposures(const std::string& securityId) {
+  if(securityId.empty())
+    throw std::invalid_argument("Error: security ID is empty!");
+
+  Shard& shard = *m_shards[shardIndex(securityId)];
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  return shard.cache.getCompanyExposures(securityId);
+}
+
+OrderSnapshot ConcurrentOrderCache::snapshot() {
+  // building a book caches it in its shard, which needs the write lock
+  std::vector<std::unique_lock<std::shared_mutex>> locks;
+  locks.reserve(m_shards.size());
+  for(auto& shard: m_shards)
+    locks.emplace_back(shard->mutex);
+
+  OrderSnapshot result;
+  for(auto& shard: m_shards)
+  {
+    OrderSnapshot part = shard->cache.snapshot();
+    result.m_books.insert(result.m_books.end(), part.m_books.begin(), part.m_books.end());
+    result.m_size += part.m_size;
+  }
+  return result;
+}
+
+OrderCacheStats ConcurrentOrderCache::stats() const {
+  OrderCacheStats result;
+  for(const auto& shard: m_shards)
+  {
+    std::shared_lock<std::shared_mutex> lock(shard->mutex);
+    OrderCacheStats part = shard->cache.stats();
+    for(std::size_t i = 0; i < STATS_METHOD_COUNT; i++)
+      result.latency[i] += part.latency[i];
+    result.ordersAdded += part.ordersAdded;
+    result.ordersCancelled += part.ordersCancelled;
+    result.ordersFilled += part.ordersFilled;
+    result.executedQty += part.executedQty;
+    for(auto& depth: part.maxDepth)
+      result.maxDepth.push_back(std::move(depth));
+  }
+  return result;
+}
+
+////------------------------  PRIVATE -------------------------------------------
+
+std::size_t ConcurrentOrderCache::shardIndex(const std::string& securityId) const
+{
+  return std::hash<std::string>()(securityId) % m_shards.size();
+}
+
+ConcurrentOrderCache::IdStripe& ConcurrentOrderCache::stripeOf(const std::string& orderId)
+{
+  return *m_stripes[std::hash<std::string>()(orderId) % m_stripes.size()];
+}
+
+void ConcurrentOrderCache::eraseIds(const std::vector<std::string>& ids)
+{
+  for(const auto& orderId: ids)
+  {
+    IdStripe& stripe = stripeOf(orderId);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    stripe.shardOf.erase(orderId);
+  }
+}
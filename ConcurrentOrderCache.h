@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "OrderCache.h"
+
+// Thread-safe order cache. Securities are spread by hash over shards, each an
+// OrderCache behind its own reader-writer lock, so calls for one security
+// lock only that shard. Order ids are indexed in lock-striped maps, which
+// find the shard of an order and reject duplicate ids across shards.
+// Calls spanning securities lock the shards they need in ascending order, a
+// stripe is only ever locked while holding shard locks or none.
+class ConcurrentOrderCache : public OrderCacheInterface
+{
+ public:
+  explicit ConcurrentOrderCache(std::size_t shards = 64);
+
+  ConcurrentOrderCache(const ConcurrentOrderCache&) = delete;
+  ConcurrentOrderCache& operator=(const ConcurrentOrderCache&) = delete;
+
+  void addOrder(Order order) override;
+
+  void cancelOrder(const std::string& orderId) override;
+
+  void cancelOrdersForUser(const std::string& user) override;
+
+  void cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty) override;
+
+  unsigned int getMatchingSizeForSecurity(const std::string& securityId) override;
+
+  // consistent view: every shard is read-locked while the orders are copied
+  std::vector<Order> getAllOrders() const override;
+
+  // OrderCache's exposure queries under read locks: one shard for a
+  // security, every shard at once for the total of a company. The names
+  // point into the shard caches
+  CompanyExposure getCompanyExposure(const std::string& securityId, const std::string& company);
+  CompanyExposure getCompanyExposure(const std::string& company);
+  std::vector<CompanyExposure> getCompanyExposures(const std::string& securityId);
+
+  // point-in-time copy across all shards, which stay write-locked while
+  // their changed books are copied
+  OrderSnapshot snapshot();
+
+  // stats of the shard caches added together, each shard read-locked in
+  // turn; the latencies are those of the calls the shards received
+  OrderCacheStats stats() const;
+
+  std::size_t shardCount() const { return m_shards.size(); }
+
+ private:
+   struct Shard
+   {
+     mutable std::shared_mutex mutex;
+     OrderCache cache;
+   };
+   // order id -> shard of the order
+   struct IdStripe
+   {
+     std::mutex mutex;
+     std::unordered_map<std::string, std::size_t> shardOf;
+   };
+
+   std::vector<std::unique_ptr<Shard>> m_shards;
+   std::vector<std::unique_ptr<IdStripe>> m_stripes;
+
+   std::size_t shardIndex(const std::string& securityId) const;
+   IdStripe& stripeOf(const std::string& orderId);
+
+   // removes cancelled ids from the stripes, called with the shards locked
+   void eraseIds(const std::vector<std::string>& ids);
+};
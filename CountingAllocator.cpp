@@ -0,0 +1,46 @@
+#include <cstdlib>
+#include <new>
+#include "CountingAllocator.h"
+
+std::atomic<std::size_t> heapAllocations{0};
+std::atomic<std::size_t> heapAllocatedBytes{0};
+
+void* operator new(std::size_t size)
+{
+  heapAllocations.fetch_add(1, std::memory_order_relaxed);
+  heapAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  if(void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+// std::pmr::new_delete_resource() uses the aligned forms
+void* operator new(std::size_t size, std::align_val_t align)
+{
+  heapAllocations.fetch_add(1, std::memory_order_relaxed);
+  heapAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  std::size_t alignment = static_cast<std::size_t>(align);
+  if(void* p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+  std::free(p);
+}
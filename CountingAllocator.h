@@ -0,0 +1,12 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Counters of the replaced global operator new, which the cache's default
+// memory resource also allocates from. CountingAllocator.cpp defines the
+// replacements; it is linked into the test and benchmark binaries only, in
+// its own translation unit so the compiler never inlines a replaced delete
+// into code it saw call operator new.
+extern std::atomic<std::size_t> heapAllocations;
+extern std::atomic<std::size_t> heapAllocatedBytes;
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Receives the fills of OrderCache::executeMatches() as they are executed;
+// the ids are only valid during the call
+class FillSink
+{
+ public:
+  virtual ~FillSink() = default;
+
+  virtual void fill(std::string_view buyOrderId, std::string_view sellOrderId, unsigned int qty) = 0;
+};
+
+// FillSink keeping the fills in buffers the caller sizes up front: the ids
+// back to back in one string and the fills as offsets into it, so executing
+// into a buffer reserved large enough allocates nothing. clear() keeps the
+// capacity for the next run.
+class FillBuffer : public FillSink
+{
+ public:
+  struct Fill
+  {
+    std::string_view buyOrderId;
+    std::string_view sellOrderId;
+    unsigned int qty;
+  };
+
+  void reserve(std::size_t fills, std::size_t idBytes)
+  {
+    m_fills.reserve(fills);
+    m_ids.reserve(idBytes);
+  }
+
+  void clear()
+  {
+    m_fills.clear();
+    m_ids.clear();
+  }
+
+  std::size_t size() const { return m_fills.size(); }
+  bool empty() const       { return m_fills.empty(); }
+
+  // views into the buffer, valid until the next fill or clear()
+  Fill operator[](std::size_t index) const
+  {
+    const Record& record = m_fills[index];
+    return Fill{ std::string_view(m_ids.data() + record.buyOrderId, record.buyOrderIdSize)
+      , std::string_view(m_ids.data() + record.buyOrderId + record.buyOrderIdSize, record.sellOrderIdSize)
+      , record.qty };
+  }
+
+  void fill(std::string_view buyOrderId, std::string_view sellOrderId, unsigned int qty) override
+  {
+    m_fills.push_back(Record{ static_cast<std::uint32_t>(m_ids.size()), static_cast<std::uint32_t>(buyOrderId.size())
+      , static_cast<std::uint32_t>(sellOrderId.size()), qty });
+    m_ids.append(buyOrderId);
+    m_ids.append(sellOrderId);
+  }
+
+ private:
+   // the sell order id follows the buy order id
+   struct Record
+   {
+     std::uint32_t buyOrderId;
+     std::uint32_t buyOrderIdSize;
+     std::uint32_t sellOrderIdSize;
+     unsigned int qty;
+   };
+
+   std::string m_ids;
+   std::vector<Record> m_fills;
+};
@@ -0,0 +1,104 @@
+#include <array>
+#include "FilterKernels.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define FILTER_KERNELS_AVX2 1
+#include <immintrin.h>
+#endif
+
+std::size_t selectLessScalar(const unsigned int* values, std::size_t count, unsigned int limit, std::uint32_t* sel)
+{
+  // branch-free: the position is always written and kept only if it passes
+  std::size_t kept = 0;
+  for(std::size_t i = 0; i < count; i++)
+  {
+    sel[kept] = static_cast<std::uint32_t>(i);
+    kept += values[i] < limit;
+  }
+  return kept;
+}
+
+#ifdef FILTER_KERNELS_AVX2
+
+// lane permutation moving the lanes set in an 8-bit mask to the front
+using LaneTable = std::array<std::array<std::uint32_t, 8>, 256>;
+
+static LaneTable makeLaneTable()
+{
+  LaneTable table{};
+  for(std::uint32_t mask = 0; mask < 256; mask++)
+  {
+    std::size_t kept = 0;
+    for(std::uint32_t lane = 0; lane < 8; lane++)
+    {
+      if(mask & (1u << lane))
+        table[mask][kept++] = lane;
+    }
+  }
+  return table;
+}
+
+static const LaneTable LANES = makeLaneTable();
+
+__attribute__((target("avx2")))
+static std::size_t selectLessVector(const unsigned int* values, std::size_t count, unsigned int limit, std::uint32_t* sel)
+{
+  if(!limit)
+    return 0;
+
+  // unsigned v < limit is v == min(v, limit - 1)
+  const __m256i max = _mm256_set1_epi32(static_cast<int>(limit - 1));
+  const __m256i step = _mm256_set1_epi32(8);
+  __m256i positions = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  std::size_t kept = 0;
+  std::size_t i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+    __m256i pass = _mm256_cmpeq_epi32(_mm256_min_epu32(v, max), v);
+    unsigned int mask = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_castsi256_ps(pass)));
+    __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(LANES[mask].data()));
+    // kept <= i, so the 8 stored positions stay inside the first count slots
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(sel + kept), _mm256_permutevar8x32_epi32(positions, lanes));
+    kept += static_cast<std::size_t>(__builtin_popcount(mask));
+    positions = _mm256_add_epi32(positions, step);
+  }
+  for(; i < count; i++)
+  {
+    sel[kept] = static_cast<std::uint32_t>(i);
+    kept += values[i] < limit;
+  }
+  return kept;
+}
+
+#endif
+
+std::size_t selectLessAvx2(const unsigned int* values, std::size_t count, unsigned int limit, std::uint32_t* sel)
+{
+#ifdef FILTER_KERNELS_AVX2
+  if(hasAvx2())
+    return selectLessVector(values, count, limit, sel);
+#endif
+  return selectLessScalar(values, count, limit, sel);
+}
+
+bool hasAvx2()
+{
+#ifdef FILTER_KERNELS_AVX2
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+#else
+  return false;
+#endif
+}
+
+std::size_t selectLess(const unsigned int* values, std::size_t count, unsigned int limit, std::uint32_t* sel)
+{
+  using SelectFn = std::size_t (*)(const unsigned int*, std::size_t, unsigned int, std::uint32_t*);
+#ifdef FILTER_KERNELS_AVX2
+  static const SelectFn select = hasAvx2() ? selectLessVector : selectLessScalar;
+#else
+  static const SelectFn select = selectLessScalar;
+#endif
+  return select(values, count, limit, sel);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Filter kernels over the columns of a security book. A select kernel writes
+// the positions of the values passing its predicate to sel in ascending order
+// and returns how many there are; sel needs room for count positions. The
+// positions are then used to compact every column of the book in place.
+
+// positions of values < limit, uses AVX2 when the CPU supports it
+std::size_t selectLess(const unsigned int* values, std::size_t count, unsigned int limit, std::uint32_t* sel);
+
+// the implementations selectLess() chooses from, exposed for tests and benchmarks
+std::size_t selectLessScalar(const unsigned int* values, std::size_t count, unsigned int limit, std::uint32_t* sel);
+std::size_t selectLessAvx2(const unsigned int* values, std::size_t count, unsigned int limit, std::uint32_t* sel);
+
+// true when selectLessAvx2() runs vector code on this CPU, otherwise it falls
+// back to the scalar loop
+bool hasAvx2();
+
+// keeps column[sel[0]], ..., column[sel[count-1]] at the front of the column
+// and drops the rest; sel is ascending so no kept value is overwritten early
+template<typename T, typename Alloc>
+void compactColumn(std::vector<T, Alloc>& column, const std::uint32_t* sel, std::size_t count)
+{
+  for(std::size_t i = 0; i < count; i++)
+  {
+    if(sel[i] != i)
+      column[i] = std::move(column[sel[i]]);
+  }
+  column.resize(count);
+}
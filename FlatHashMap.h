@@ -0,0 +1,304 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLAT_HASH_MAP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Hash for integer keys such as dense ids: std::hash is the identity for
+// them, which would put consecutive ids in the same first group
+struct IntegerHash
+{
+  std::size_t operator()(std::uint64_t value) const
+  {
+    // finalizer of MurmurHash3, every input bit affects every output bit
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return static_cast<std::size_t>(value);
+  }
+};
+
+// Open-addressing hash map in the SwissTable layout: keys and values sit in
+// one flat slot array, and a parallel array of control bytes holds 7 bits of
+// each key's hash, or marks the slot empty or deleted. A lookup loads the
+// control bytes of a 16-slot group at once, compares them with the hash
+// bits in one SSE2 instruction, and touches only the slots that match.
+// Groups are probed quadratically and a group holding an empty slot ends
+// the probe.
+//
+// Key and Value must be trivially copyable, and are copied around when the
+// table grows. With Key = std::string_view the map does not own the
+// characters: they must stay in place while the key is in the map, and any
+// string converting to std::string_view can be looked up without a copy.
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlatHashMap
+{
+  static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value
+    , "FlatHashMap needs trivially copyable keys and values");
+
+ public:
+  explicit FlatHashMap(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : m_resource(resource) { }
+
+  FlatHashMap(FlatHashMap&& other) noexcept
+      : m_resource(other.m_resource),
+        m_ctrl(std::exchange(other.m_ctrl, nullptr)),
+        m_slots(std::exchange(other.m_slots, nullptr)),
+        m_capacity(std::exchange(other.m_capacity, 0)),
+        m_size(std::exchange(other.m_size, 0)),
+        m_deleted(std::exchange(other.m_deleted, 0)) { }
+
+  FlatHashMap(const FlatHashMap&) = delete;
+  FlatHashMap& operator=(const FlatHashMap&) = delete;
+
+  ~FlatHashMap() { release(); }
+
+  std::size_t size() const     { return m_size; }
+  bool empty() const           { return m_size == 0; }
+  std::size_t capacity() const { return m_capacity; }
+
+  // the value of the key or nullptr
+  Value* find(const Key& key)
+  {
+    std::size_t index = findIndex(key, Hash()(key));
+    return index == NPOS ? nullptr : &m_slots[index].value;
+  }
+
+  const Value* find(const Key& key) const { return const_cast<FlatHashMap*>(this)->find(key); }
+
+  bool contains(const Key& key) const { return find(key) != nullptr; }
+
+  // inserts the key with value unless it is present; returns its value and
+  // whether it was inserted, hashing the key once either way
+  std::pair<Value*, bool> tryEmplace(const Key& key, const Value& value)
+  {
+    std::size_t hash = Hash()(key);
+    std::size_t index = findIndex(key, hash);
+    if(index != NPOS)
+      return { &m_slots[index].value, false };
+
+    if((m_size + m_deleted + 1) * 8 > m_capacity * 7)
+      grow();
+    index = findFree(hash);
+    if(m_ctrl[index] == DELETED)
+      m_deleted--;
+    m_ctrl[index] = h2(hash);
+    m_slots[index].key = key;
+    m_slots[index].value = value;
+    m_size++;
+    return { &m_slots[index].value, true };
+  }
+
+  // false when the key is not present
+  bool erase(const Key& key)
+  {
+    std::size_t index = findIndex(key, Hash()(key));
+    if(index == NPOS)
+      return false;
+
+    // a probe never passes a group with an empty slot, so within such a
+    // group the slot can go back to empty instead of leaving a tombstone
+    if(matchEmpty(m_ctrl + index / GROUP_SIZE * GROUP_SIZE))
+      m_ctrl[index] = EMPTY;
+    else
+    {
+      m_ctrl[index] = DELETED;
+      m_deleted++;
+    }
+    m_size--;
+    return true;
+  }
+
+  // makes room for count keys without rehashing
+  void reserve(std::size_t count)
+  {
+    std::size_t capacity = requiredCapacity(count);
+    if(capacity > m_capacity)
+      rehash(capacity);
+  }
+
+  void clear()
+  {
+    if(m_capacity)
+      std::memset(m_ctrl, EMPTY, m_capacity);
+    m_size = 0;
+    m_deleted = 0;
+  }
+
+  // calls visitor(key, value) for every entry, in no particular order
+  template<typename Visitor>
+  void forEach(Visitor&& visitor) const
+  {
+    for(std::size_t i = 0; i < m_capacity; i++)
+    {
+      if(m_ctrl[i] >= 0)
+        visitor(m_slots[i].key, m_slots[i].value);
+    }
+  }
+
+ private:
+   struct Slot
+   {
+     Key key;
+     Value value;
+   };
+
+   static constexpr std::size_t GROUP_SIZE = 16;
+   static constexpr std::size_t NPOS = ~std::size_t(0);
+   static constexpr std::int8_t EMPTY = -128;
+   static constexpr std::int8_t DELETED = -2;
+
+   std::pmr::memory_resource* m_resource;
+   std::int8_t* m_ctrl = nullptr;  // per slot: EMPTY, DELETED or the low 7 hash bits
+   Slot* m_slots = nullptr;
+   std::size_t m_capacity = 0;     // 0 or a power of two of at least GROUP_SIZE
+   std::size_t m_size = 0;
+   std::size_t m_deleted = 0;
+
+   static std::int8_t h2(std::size_t hash) { return static_cast<std::int8_t>(hash & 0x7F); }
+   // the group probed first, from the hash bits h2() does not use
+   std::size_t h1(std::size_t hash) const { return (hash >> 7) & (m_capacity / GROUP_SIZE - 1); }
+
+   // bit i set when control byte i of the group equals value
+   static std::uint32_t match(const std::int8_t* group, std::int8_t value)
+   {
+#ifdef FLAT_HASH_MAP_SSE2
+     __m128i bytes = _mm_load_si128(reinterpret_cast<const __m128i*>(group));
+     return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value))));
+#else
+     std::uint32_t mask = 0;
+     for(std::size_t i = 0; i < GROUP_SIZE; i++)
+       mask |= std::uint32_t(group[i] == value) << i;
+     return mask;
+#endif
+   }
+
+   static std::uint32_t matchEmpty(const std::int8_t* group) { return match(group, EMPTY); }
+
+   // bit i set when slot i of the group is empty or deleted, whose control
+   // bytes are the only negative ones
+   static std::uint32_t matchFree(const std::int8_t* group)
+   {
+#ifdef FLAT_HASH_MAP_SSE2
+     return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(group))));
+#else
+     std::uint32_t mask = 0;
+     for(std::size_t i = 0; i < GROUP_SIZE; i++)
+       mask |= std::uint32_t(group[i] < 0) << i;
+     return mask;
+#endif
+   }
+
+   static unsigned int lowestBit(std::uint32_t mask)
+   {
+#if defined(__GNUC__) || defined(__clang__)
+     return static_cast<unsigned int>(__builtin_ctz(mask));
+#else
+     unsigned int bit = 0;
+     while(!(mask & 1))
+     {
+       mask >>= 1;
+       bit++;
+     }
+     return bit;
+#endif
+   }
+
+   std::size_t findIndex(const Key& key, std::size_t hash) const
+   {
+     if(!m_capacity)
+       return NPOS;
+     std::size_t groupMask = m_capacity / GROUP_SIZE - 1;
+     std::int8_t tag = h2(hash);
+     for(std::size_t group = h1(hash), step = 1; ; group = (group + step++) & groupMask)
+     {
+       const std::int8_t* ctrl = m_ctrl + group * GROUP_SIZE;
+       for(std::uint32_t mask = match(ctrl, tag); mask; mask &= mask - 1)
+       {
+         std::size_t index = group * GROUP_SIZE + lowestBit(mask);
+         if(m_slots[index].key == key)
+           return index;
+       }
+       if(matchEmpty(ctrl))
+         return NPOS;
+     }
+   }
+
+   // first empty or deleted slot on the probe sequence of hash; the load
+   // limit guarantees there is one
+   std::size_t findFree(std::size_t hash) const
+   {
+     std::size_t groupMask = m_capacity / GROUP_SIZE - 1;
+     for(std::size_t group = h1(hash), step = 1; ; group = (group + step++) & groupMask)
+     {
+       std::uint32_t mask = matchFree(m_ctrl + group * GROUP_SIZE);
+       if(mask)
+         return group * GROUP_SIZE + lowestBit(mask);
+     }
+   }
+
+   // smallest capacity holding count keys at most 7/8 full
+   static std::size_t requiredCapacity(std::size_t count)
+   {
+     std::size_t capacity = GROUP_SIZE;
+     while(count * 8 > capacity * 7)
+       capacity *= 2;
+     return capacity;
+   }
+
+   // doubles, or only drops the tombstones when there are as many as keys
+   void grow()
+   {
+     rehash(requiredCapacity(m_deleted >= m_size ? m_size + 1 : (m_size + 1) * 2));
+   }
+
+   void rehash(std::size_t capacity)
+   {
+     std::int8_t* oldCtrl = m_ctrl;
+     Slot* oldSlots = m_slots;
+     std::size_t oldCapacity = m_capacity;
+
+     m_ctrl = static_cast<std::int8_t*>(m_resource->allocate(capacity, GROUP_SIZE));
+     m_slots = static_cast<Slot*>(m_resource->allocate(capacity * sizeof(Slot), alignof(Slot)));
+     m_capacity = capacity;
+     m_deleted = 0;
+     std::memset(m_ctrl, EMPTY, capacity);
+     for(std::size_t i = 0; i < oldCapacity; i++)
+     {
+       if(oldCtrl[i] < 0)
+         continue;
+       std::size_t hash = Hash()(oldSlots[i].key);
+       std::size_t index = findFree(hash);
+       m_ctrl[index] = h2(hash);
+       m_slots[index] = oldSlots[i];
+     }
+
+     if(oldCapacity)
+     {
+       m_resource->deallocate(oldCtrl, oldCapacity, GROUP_SIZE);
+       m_resource->deallocate(oldSlots, oldCapacity * sizeof(Slot), alignof(Slot));
+     }
+   }
+
+   void release()
+   {
+     if(!m_capacity)
+       return;
+     m_resource->deallocate(m_ctrl, m_capacity, GROUP_SIZE);
+     m_resource->deallocate(m_slots, m_capacity * sizeof(Slot), alignof(Slot));
+     m_ctrl = nullptr;
+     m_slots = nullptr;
+     m_capacity = 0;
+   }
+};
@@ -0,0 +1,65 @@
+#include <fstream>
+#include <stdexcept>
+#include "MappedFile.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_FILE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path)
+{
+#ifdef MAPPED_FILE_MMAP
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+    throw std::runtime_error("Error: cannot open file!");
+  struct stat status;
+  if(::fstat(fd, &status) != 0)
+  {
+    ::close(fd);
+    throw std::runtime_error("Error: cannot open file!");
+  }
+  m_size = static_cast<std::size_t>(status.st_size);
+  if(m_size)
+  {
+    void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED)
+    {
+      ::close(fd);
+      throw std::runtime_error("Error: cannot open file!");
+    }
+    m_data = static_cast<const char*>(data);
+    m_mapped = true;
+  }
+  ::close(fd);
+#else
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if(!file)
+    throw std::runtime_error("Error: cannot open file!");
+  m_buffer.resize(static_cast<std::size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+  m_size = m_buffer.size();
+  if(m_size)
+    m_data = m_buffer.data();
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef MAPPED_FILE_MMAP
+  if(m_mapped)
+    ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+}
+
+void MappedFile::adviseSequential() const
+{
+#ifdef MAPPED_FILE_MMAP
+  if(m_mapped)
+    ::madvise(const_cast<char*>(m_data), m_size, MADV_SEQUENTIAL);
+#endif
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file, memory-mapped where the platform allows
+// and read into memory otherwise. Throws std::runtime_error if the file
+// cannot be opened.
+class MappedFile
+{
+ public:
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const  { return m_data; }
+  std::size_t size() const  { return m_size; }
+
+  // hints that the file is read front to back once
+  void adviseSequential() const;
+
+ private:
+   const char* m_data = "";
+   std::size_t m_size = 0;
+   bool m_mapped = false;
+   std::vector<char> m_buffer;  // file contents where mapping is not available
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free ring buffer for many producers and one consumer. Every
+// cell carries a sequence number: a producer claims a position with one CAS
+// on the tail and publishes the value by advancing the cell's sequence, the
+// consumer frees the cell for the producers one lap later the same way.
+// A full ring makes tryPush() fail instead of blocking, which is the
+// backpressure signal to the producer.
+template<typename T>
+class MpscRing
+{
+ public:
+  // capacity is rounded up to a power of two
+  explicit MpscRing(std::size_t capacity)
+  {
+    std::size_t size = 2;
+    while(size < capacity)
+      size *= 2;
+    m_cells = std::make_unique<Cell[]>(size);
+    m_mask = size - 1;
+    for(std::size_t i = 0; i < size; i++)
+      m_cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  MpscRing(const MpscRing&) = delete;
+  MpscRing& operator=(const MpscRing&) = delete;
+
+  std::size_t capacity() const { return m_mask + 1; }
+
+  // any thread; the value is moved from only when the push succeeds
+  template<typename U>
+  bool tryPush(U&& value)
+  {
+    std::size_t pos = m_tail.load(std::memory_order_relaxed);
+    Cell* cell;
+    while(true)
+    {
+      cell = &m_cells[pos & m_mask];
+      std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+      if(diff == 0)
+      {
+        if(m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if(diff < 0)
+        return false;  // the cell still holds the value of the previous lap
+      else
+        pos = m_tail.load(std::memory_order_relaxed);
+    }
+    cell->value = std::forward<U>(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer thread only
+  bool tryPop(T& value)
+  {
+    Cell& cell = m_cells[m_head & m_mask];
+    if(cell.sequence.load(std::memory_order_acquire) != m_head + 1)
+      return false;
+    value = std::move(cell.value);
+    cell.sequence.store(m_head + m_mask + 1, std::memory_order_release);
+    m_head++;
+    return true;
+  }
+
+ private:
+   struct Cell
+   {
+     std::atomic<std::size_t> sequence;
+     T value;
+   };
+
+   std::unique_ptr<Cell[]> m_cells;
+   std::size_t m_mask = 0;
+   alignas(64) std::atomic<std::size_t> m_tail{0};  // next position for the producers
+   alignas(64) std::size_t m_head = 0;              // next position for the consumer
+};
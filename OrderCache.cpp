@@ -1,176 +1,1531 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <stdexcept>
+#include <iterator>
+#include <new>
+#include "FillSink.h"
+#include "FilterKernels.h"
+#include "MappedFile.h"
 #include "OrderCache.h"
-#include "gtest/gtest.h"
+#include "OrderFile.h"
+#include "OrderJournal.h"
+#include "WorkStealingPool.h"
 
 static constexpr std::string_view BUY = "Buy";
 static constexpr std::string_view SELL = "Sell";
 
-void OrderCache::addOrder(Order order) {
-  if(order.orderId().empty())
-    throw std::invalid_argument("Error: order ID is empty!");
-  if(order.securityId().empty())
-    throw std::invalid_argument("Error: security ID is empty!");
-  if(order.user().empty())
-    throw std::invalid_argument("Error: user ID is empty!");
-  if(order.company().empty())
-    throw std::invalid_argument("Error: company name is empty!");
-  if(order.side().empty())
-    throw std::invalid_argument("Error: side is empty!");
-  if(!order.qty())
-    throw std::invalid_argument("Error: qty is zero!");  
-  if(m_orderIds.find(order.orderId()) != m_orderIds.end())
-    throw std::runtime_error("Error: order ID have already exist!");
-  m_orderIds.insert(order.orderId());
-
-  if(order.side() == BUY)
-    m_buyOrders[order.securityId()].push_back({ order });
-  else if(order.side() == SELL)
-    m_sellOrders[order.securityId()].push_back({ order });
-  else
-    throw std::invalid_argument("Error:invalid side!");
+static std::size_t sideIndex(Side side) { return static_cast<std::size_t>(side); }
+
+// a minimum qty cancel removing at least 1/BULK_CANCEL_DIVISOR of a side
+// compacts the columns in one pass instead of swap-moving order by order
+static constexpr std::size_t BULK_CANCEL_DIVISOR = 8;
+
+// bytes of an order file parsed by one task of loadOrderFile()
+static constexpr std::size_t ORDER_FILE_CHUNK_SIZE = 1 << 20;
+
+template<typename IdPolicy, typename StatsPolicy>
+BasicOrderCache<IdPolicy, StatsPolicy>::BasicOrderCache(Resource* resource)
+    : m_resource(resource),
+      m_state(createState()) { }
+
+template<typename IdPolicy, typename StatsPolicy>
+BasicOrderCache<IdPolicy, StatsPolicy>::BasicOrderCache(Arena arena)
+    : m_arena(std::make_unique<std::pmr::monotonic_buffer_resource>(arena.initialSize)),
+      m_resource(m_arena.get()),
+      m_state(createState()) { }
+
+template<typename IdPolicy, typename StatsPolicy>
+BasicOrderCache<IdPolicy, StatsPolicy>::~BasicOrderCache() {
+  destroyState();
 }
 
-void OrderCache::cancelOrder(const std::string& orderId) {
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::addOrder(Order order) {
+  [[maybe_unused]] auto timer = m_stats.time(StatsMethod::AddOrder);
+  if(m_book)
+    materialize();
+
+  OrderError error = validate(order);
+  if(error != OrderError::None)
+    throwError(error);
+
+  OrderRef ref = insertOrderId(order.m_orderId);
+  if(ref == NO_REF)
+    throwError(OrderError::DuplicateOrderId);
+  Side side = parseSide(order.m_side);
+  if(m_journal)
+    journalAdd(ref, order.m_orderId, order.m_securityId, side, order.m_qty, order.m_user, order.m_company);
+  insertOrder(ref, internSecurity(order.m_securityId), side, order);
+  m_stats.ordersAdded(1);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::emplaceOrder(std::string_view orderId, std::string_view securityId, std::string_view side
+  , unsigned int qty, std::string_view user, std::string_view company) {
+  [[maybe_unused]] auto timer = m_stats.time(StatsMethod::AddOrder);
+  OrderError error = validateFields(orderId, securityId, side, qty, user, company);
+  if(error == OrderError::None)
+    error = addOrderFields(orderId, securityId, side == BUY ? Side::Buy : Side::Sell, qty, user, company);
+  if(error != OrderError::None)
+    throwError(error);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+std::vector<BatchError> BasicOrderCache<IdPolicy, StatsPolicy>::addOrders(std::vector<Order>&& orders) {
+  [[maybe_unused]] auto timer = m_stats.time(StatsMethod::AddOrders);
+  if(m_book)
+    materialize();
+
+  std::vector<BatchError> errors;
+  m_state->orderIndex.reserve(m_state->orderIndex.size() + orders.size());
+
+  // validate and index the ids in batch order, so the first of two equal ids wins
+  struct Accepted
+  {
+    std::size_t index;
+    OrderRef ref;
+    SymbolId securityId;
+    Side side;
+  };
+  std::vector<Accepted> accepted;
+  accepted.reserve(orders.size());
+  for(std::size_t i = 0; i < orders.size(); i++)
+  {
+    OrderError error = validate(orders[i]);
+    if(error != OrderError::None)
+    {
+      errors.push_back({ i, error });
+      continue;
+    }
+    OrderRef ref = insertOrderId(orders[i].m_orderId);
+    if(ref == NO_REF)
+    {
+      errors.push_back({ i, OrderError::DuplicateOrderId });
+      continue;
+    }
+    accepted.push_back({ i, ref, internSecurity(orders[i].m_securityId), parseSide(orders[i].m_side) });
+  }
+
+  if(m_journal)
+  {
+    // a failed journal rejects the whole batch before any order is placed
+    try
+    {
+      for(auto& order: accepted)
+      {
+        const Order& added = orders[order.index];
+        m_journal->recordAdd(added.m_orderId, added.m_securityId, order.side, added.m_qty, added.m_user
+          , added.m_company);
+      }
+    }
+    catch(...)
+    {
+      for(auto& order: accepted)
+        releaseOrderId(order.ref);
+      throw;
+    }
+  }
+
+  // group by security and side with a counting sort, so every book side is
+  // sized once and then filled in one go
+  std::vector<std::size_t> offsets(2 * m_state->books.size() + 1, 0);
+  for(auto& order: accepted)
+    offsets[2 * order.securityId + sideIndex(order.side) + 1]++;
+  for(std::size_t slot = 0; slot + 1 < offsets.size(); slot++)
+  {
+    if(offsets[slot + 1])
+    {
+      auto& book = m_state->books[slot / 2].sides[slot % 2];
+      book.reserve(book.size() + offsets[slot + 1]);
+    }
+    offsets[slot + 1] += offsets[slot];
+  }
+  std::vector<std::size_t> grouped(accepted.size());
+  for(std::size_t i = 0; i < accepted.size(); i++)
+    grouped[offsets[2 * accepted[i].securityId + sideIndex(accepted[i].side)]++] = i;
+
+  for(std::size_t i: grouped)
+  {
+    auto& order = accepted[i];
+    insertOrder(order.ref, order.securityId, order.side, orders[order.index]);
+  }
+  m_stats.ordersAdded(accepted.size());
+  return errors;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::cancelOrder(const std::string& orderId) {
+  [[maybe_unused]] auto timer = m_stats.time(StatsMethod::CancelOrder);
   if(orderId.empty())
     throw std::invalid_argument("Error: order ID is empty!");
-    
-  m_orderIds.erase(orderId);
-  if(cancelOrder(orderId, m_buyOrders))
-    return;
-  if(cancelOrder(orderId, m_sellOrders))
-    return;
+
+  cancelOrderId(orderId);
 }
 
-void OrderCache::cancelOrdersForUser(const std::string& user) {
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::cancelOrdersForUser(const std::string& user) {
+  [[maybe_unused]] auto timer = m_stats.time(StatsMethod::CancelOrdersForUser);
   if(user.empty())
     throw std::invalid_argument("Error: user is empty!");
+  if(m_journal)
+    m_journal->recordCancelForUser(user);
+  if(m_book)
+  {
+    // a user without orders in the loaded book leaves it mapped
+    std::size_t index = 0;
+    while(index < m_book->userCount() && m_book->user(index) != user)
+      index++;
+    if(index == m_book->userCount())
+      return;
+    materialize();
+  }
 
-  cancelOrdersForUser(user, m_buyOrders, m_orderIds);
-  cancelOrdersForUser(user, m_sellOrders, m_orderIds);
+  SymbolId userId = m_state->users.find(user);
+  if(userId == SymbolTable::npos)
+    return;
+
+  std::pmr::vector<OrderRef> refs(m_resource);
+  refs.swap(m_state->userOrders[userId]);
+  for(OrderRef ref: refs)
+    erase(ref);
+  m_stats.ordersCancelled(refs.size());
 }
 
-void OrderCache::cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty) {
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty) {
+  [[maybe_unused]] auto timer = m_stats.time(StatsMethod::CancelOrdersForSecIdWithMinimumQty);
   if(securityId.empty())
     throw std::invalid_argument("Error: security ID is empty!");
   if(!minQty)
     throw std::invalid_argument("Error: minQty is zero!");
+  if(m_journal)
+    m_journal->recordCancelForSecIdWithMinimumQty(securityId, minQty);
+  if(m_book)
+  {
+    if(m_book->findSecurity(securityId) == book_file::EMPTY_SLOT)
+      return;
+    materialize();
+  }
+
+  SymbolId id = m_state->securities.find(securityId);
+  if(id == SymbolTable::npos)
+    return;
+
+  // orders with qty >= minQty are all those of the buckets above the one of
+  // minQty and part of that one
+  auto& book = m_state->books[id];
+  std::size_t first = SecurityOrders::qtyBucket(minQty);
+  for(Side side: { Side::Buy, Side::Sell })
+  {
+    auto& orders = book.sides[sideIndex(side)];
+    std::size_t removed = 0;
+    for(OrderRef ref: orders.byQty[first])
+      removed += orders.qty[m_state->locations[ref].index] >= minQty;
+    for(std::size_t bucket = first + 1; bucket < SecurityOrders::QTY_BUCKETS; bucket++)
+      removed += orders.byQty[bucket].size();
+    if(removed * BULK_CANCEL_DIVISOR >= orders.size())
+    {
+      eraseTail(book, side, first, minQty);
+      continue;
+    }
 
-  cancelOrdersForSecIdWithMinimumQty(securityId, minQty, m_buyOrders, m_orderIds);
-  cancelOrdersForSecIdWithMinimumQty(securityId, minQty, m_sellOrders, m_orderIds);
+    // erase() swap-moves the last order of a bucket into the freed slot, so
+    // going backwards every slot is visited once
+    for(std::size_t bucket = first; bucket < SecurityOrders::QTY_BUCKETS; bucket++)
+    {
+      auto& refs = orders.byQty[bucket];
+      for(std::size_t i = refs.size(); i-- > 0; )
+      {
+        if(orders.qty[m_state->locations[refs[i]].index] >= minQty)
+          erase(refs[i]);
+      }
+    }
+    m_stats.ordersCancelled(removed);
+  }
 }
 
-unsigned int OrderCache::getMatchingSizeForSecurity(const std::string& securityId) {
+template<typename IdPolicy, typename StatsPolicy>
+unsigned int BasicOrderCache<IdPolicy, StatsPolicy>::getMatchingSizeForSecurity(const std::string& securityId) {
+  [[maybe_unused]] auto timer = m_stats.time(StatsMethod::GetMatchingSizeForSecurity);
   if(securityId.empty())
     throw std::invalid_argument("Error: security ID is empty!");
 
-  unsigned int totalQty = 0;
-  auto& vecSell = m_sellOrders[securityId];
-  for(std::size_t i = 0; i < vecSell.size(); i++)
+  unsigned int size = 0;
+  if(m_book)
   {
-    auto& vecBuy = m_buyOrders[securityId];
-    for(std::size_t j = 0; j < vecBuy.size(); j++)
-    {
-      if(vecSell[i].company() == vecBuy[j].company())
-        continue;
+    std::uint32_t index = m_book->findSecurity(securityId);
+    if(index != book_file::EMPTY_SLOT)
+      size = m_book->securityRun(index).matchingSize;
+  }
+  else
+  {
+    SymbolId id = m_state->securities.find(securityId);
+    if(id != SymbolTable::npos)
+      size = matchingSize(m_state->books[id].totals);
+  }
+  return size;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+std::vector<SecurityMatchingSize> BasicOrderCache<IdPolicy, StatsPolicy>::getMatchingSizeForAllSecurities(unsigned int threads) {
+  [[maybe_unused]] auto timer = m_stats.time(StatsMethod::GetMatchingSizeForAllSecurities);
+  WorkStealingPool& workers = pool(threads);
 
-      if(vecSell[i].currentQty >= vecBuy[j].currentQty)
+  // each task touches only the totals of its own securities; a loaded book
+  // stores the matching size of each of its securities
+  std::vector<SecurityMatchingSize> result(m_book ? m_book->securityCount() : m_state->books.size());
+  std::size_t grain = std::max<std::size_t>(1, result.size() / (workers.size() * 16));
+  workers.parallelFor(result.size(), grain, [this, &result](std::size_t begin, std::size_t end) {
+    for(std::size_t index = begin; index < end; index++)
+    {
+      if(m_book)
       {
-        totalQty += vecBuy[j].currentQty;
-        vecSell[i].currentQty -= vecBuy[j].currentQty;
-        erase(vecBuy, j);
-        if(!vecSell[i].currentQty)
-        {
-          erase(vecSell, i);
-          break;
-        }
+        result[index].securityId = m_state->securities.name(m_state->bookSecurities[index]);
+        result[index].matchingSize = m_book->securityRun(index).matchingSize;
       }
       else
       {
-        totalQty += vecSell[i].currentQty;
-        vecBuy[j].currentQty -= vecSell[i].currentQty;
-        erase(vecSell, i);
-        break;
+        result[index].securityId = m_state->securities.name(static_cast<SymbolId>(index));
+        result[index].matchingSize = matchingSize(m_state->books[index].totals);
       }
     }
-  }
-  return totalQty;
+  });
+  return result;
 }
 
-std::vector<Order> OrderCache::getAllOrders() const {
+template<typename IdPolicy, typename StatsPolicy>
+unsigned long long BasicOrderCache<IdPolicy, StatsPolicy>::executeMatches(const std::string& securityId, FillSink& sink) {
+  [[maybe_unused]] auto timer = m_stats.time(StatsMethod::ExecuteMatches);
+  if(securityId.empty())
+    throw std::invalid_argument("Error: security ID is empty!");
+
+  return executeSecurity(securityId, sink);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+CompanyExposure BasicOrderCache<IdPolicy, StatsPolicy>::getCompanyExposure(const std::string& securityId, const std::string& company) {
+  [[maybe_unused]] auto timer = m_stats.time(StatsMethod::GetCompanyExposure);
+  if(securityId.empty())
+    throw std::invalid_argument("Error: security ID is empty!");
+  if(company.empty())
+    throw std::invalid_argument("Error: company name is empty!");
+
+  const CompanyQtyMap* companies = companyTotals(securityId);
+  SymbolId companyId = m_state->companies.find(company);
+  if(!companies || companyId == SymbolTable::npos)
+    return CompanyExposure{ {}, 0, 0 };
+  const CompanyQty* qty = companies->find(companyId);
+  if(!qty)
+    return CompanyExposure{ m_state->companies.name(companyId), 0, 0 };
+  return CompanyExposure{ m_state->companies.name(companyId), qty->buyQty, qty->sellQty };
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+CompanyExposure BasicOrderCache<IdPolicy, StatsPolicy>::getCompanyExposure(const std::string& company) {
+  [[maybe_unused]] auto timer = m_stats.time(StatsMethod::GetCompanyExposure);
+  if(company.empty())
+    throw std::invalid_argument("Error: company name is empty!");
+
+  // a company is interned before its first order updates the totals
+  const auto& totals = m_book ? m_state->bookCompanyTotals : m_state->companyTotals;
+  SymbolId companyId = m_state->companies.find(company);
+  if(companyId == SymbolTable::npos || companyId >= totals.size())
+    return CompanyExposure{ {}, 0, 0 };
+  const CompanyQty& qty = totals[companyId];
+  return CompanyExposure{ m_state->companies.name(companyId), qty.buyQty, qty.sellQty };
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+std::vector<CompanyExposure> BasicOrderCache<IdPolicy, StatsPolicy>::getCompanyExposures(const std::string& securityId) {
+  [[maybe_unused]] auto timer = m_stats.time(StatsMethod::GetCompanyExposures);
+  if(securityId.empty())
+    throw std::invalid_argument("Error: security ID is empty!");
+
+  std::vector<CompanyExposure> exposures;
+  const CompanyQtyMap* companies = companyTotals(securityId);
+  if(!companies)
+    return exposures;
+  exposures.reserve(companies->size());
+  companies->forEach([&](SymbolId companyId, const CompanyQty& qty) {
+    exposures.push_back(CompanyExposure{ m_state->companies.name(companyId), qty.buyQty, qty.sellQty });
+  });
+  return exposures;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+std::vector<Order> BasicOrderCache<IdPolicy, StatsPolicy>::getAllOrders() const {
+  [[maybe_unused]] auto timer = m_stats.time(StatsMethod::GetAllOrders);
   std::vector<Order> orders;
-  orders.reserve(m_buyOrders.size() + m_sellOrders.size());
-  for(auto& pair: m_buyOrders)
+  orders.reserve(orderCount());
+  forEachOrder([&orders](const OrderView& order) {
+    orders.push_back(makeOrder(order));
+  });
+  return orders;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+typename BasicOrderCache<IdPolicy, StatsPolicy>::OrderRange BasicOrderCache<IdPolicy, StatsPolicy>::orders() {
+  if(m_book)
+    materialize();
+
+  return OrderRange(OrderIterator(m_state, 0)
+    , OrderIterator(m_state, static_cast<SymbolId>(m_state->books.size())), m_state->orderIndex.size());
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+OrderSnapshot BasicOrderCache<IdPolicy, StatsPolicy>::snapshot() {
+  if(m_book)
+    materialize();
+
+  OrderSnapshot result;
+  for(SymbolId securityId = 0; securityId < m_state->books.size(); securityId++)
   {
-    for(std::size_t i = 0; i < pair.second.size(); i++)
-      orders.push_back(pair.second[i]);
+    auto& book = m_state->books[securityId];
+    if(!book.sides[0].size() && !book.sides[1].size())
+      continue;
+    if(!book.totals.snapshot)
+      book.totals.snapshot = makeSnapshotBook(securityId);
+    result.m_books.push_back(book.totals.snapshot);
+    result.m_size += book.totals.snapshot->records.size();
   }
-  for(auto& pair: m_sellOrders)
+  return result;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::saveBook(const std::string& path) {
+  if(m_book)
+    materialize();
+
+  BookContents contents;
+  for(SymbolId id = 0; id < m_state->securities.size(); id++)
+    contents.securities.push_back(m_state->securities.name(id));
+  for(SymbolId id = 0; id < m_state->users.size(); id++)
+    contents.users.push_back(m_state->users.name(id));
+  for(SymbolId id = 0; id < m_state->companies.size(); id++)
+    contents.companies.push_back(m_state->companies.name(id));
+
+  contents.orderIds.reserve(m_state->orderIndex.size());
+  contents.records.reserve(m_state->orderIndex.size());
+  for(const auto& book: m_state->books)
   {
-    for(std::size_t i = 0; i < pair.second.size(); i++)
-      orders.push_back(pair.second[i]);
+    book_file::BookSecurity run{};
+    run.firstRecord = contents.records.size();
+    run.buyCount = static_cast<std::uint32_t>(book.sides[sideIndex(Side::Buy)].size());
+    run.sellCount = static_cast<std::uint32_t>(book.sides[sideIndex(Side::Sell)].size());
+    run.matchingSize = computeMatchingSize(book.totals);
+    for(const auto& orders: book.sides)
+    {
+      for(std::size_t i = 0; i < orders.size(); i++)
+      {
+        contents.orderIds.push_back(m_state->locations[orders.ref[i]].orderId);
+        contents.records.push_back(book_file::BookRecord{ orders.user[i], orders.company[i], orders.qty[i] });
+      }
+    }
+    contents.securityRuns.push_back(run);
   }
-  return orders;
+  writeBookFile(path, contents);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::loadBook(const std::string& path) {
+  // a bad file throws before the current orders are dropped
+  auto book = std::make_unique<MappedBook>(path);
+  if(m_journal)
+    m_journal->recordLoadBook(path);
+  reset();
+  m_book = std::move(book);
+  indexBook();
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+std::vector<BatchError> BasicOrderCache<IdPolicy, StatsPolicy>::loadOrderFile(const std::string& path, unsigned int threads) {
+  MappedFile file(path);
+  file.adviseSequential();
+  WorkStealingPool& workers = pool(threads);
+
+  // the file is parsed a window of chunks at a time, which bounds the memory
+  // held by parsed lines; chunks end after a newline so no line is split
+  const std::size_t chunkCount = workers.size() * 4;
+  std::vector<const char*> bounds(chunkCount + 1);
+  std::vector<std::vector<OrderLine>> chunks(chunkCount);
+  std::vector<std::size_t> lineCounts(chunkCount);
+  std::vector<BatchError> errors;
+  std::size_t firstLine = 0;
+  const char* end = file.data() + file.size();
+  for(const char* pos = file.data(); pos < end; )
+  {
+    std::size_t count = 0;
+    bounds[0] = pos;
+    while(count < chunkCount && pos < end)
+    {
+      pos += std::min<std::size_t>(ORDER_FILE_CHUNK_SIZE, static_cast<std::size_t>(end - pos));
+      const char* newline = pos < end
+        ? static_cast<const char*>(std::memchr(pos, '\n', static_cast<std::size_t>(end - pos))) : nullptr;
+      pos = newline ? newline + 1 : end;
+      bounds[++count] = pos;
+    }
+
+    workers.parallelFor(count, 1, [&](std::size_t begin, std::size_t last) {
+      for(std::size_t i = begin; i < last; i++)
+      {
+        chunks[i].clear();
+        lineCounts[i] = parseOrderLines(bounds[i], bounds[i + 1], chunks[i]);
+      }
+    });
+
+    for(std::size_t i = 0; i < count; i++)
+    {
+      for(const OrderLine& line: chunks[i])
+      {
+        OrderError error = line.error;
+        if(error == OrderError::None)
+          error = addOrderFields(line.orderId, line.securityId, line.side, line.qty, line.user, line.company);
+        if(error != OrderError::None)
+          errors.push_back({ firstLine + line.line, error });
+      }
+      firstLine += lineCounts[i];
+    }
+  }
+  return errors;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+OrderCacheStats BasicOrderCache<IdPolicy, StatsPolicy>::stats() const {
+  OrderCacheStats result;
+  m_stats.copyTo(result);
+  // the depths are kept by security id, which materialize() keeps in book order
+  for(std::size_t id = 0; id < result.maxDepth.size(); id++)
+    result.maxDepth[id].securityId = m_state->securities.name(static_cast<SymbolId>(id));
+  return result;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::clear() {
+  if(m_journal)
+    m_journal->recordClear();
+  reset();
 }
 
 ////------------------------  PRIVATE -------------------------------------------
 
-void OrderCache::erase(std::vector<OrderExpander>& vctr, std::size_t& index)
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::reset()
 {
-  if(index < vctr.size()-1)
-    std::swap(vctr[index--], vctr[vctr.size()-1]);
-  vctr.erase(--vctr.end());
+  m_book.reset();
+  m_stats.clearDepths();
+  destroyState();
+  if(m_arena)
+    m_arena->release();
+  m_state = createState();
 }
 
-bool OrderCache::cancelOrder(const std::string& orderId
-    , MapOrders& mapOrders)
+template<typename IdPolicy, typename StatsPolicy>
+BasicOrderCache<IdPolicy, StatsPolicy>::State::State(Resource* resource)
+    : securities(resource),
+      users(resource),
+      companies(resource),
+      books(resource),
+      userOrders(resource),
+      companyTotals(resource),
+      bookSecurities(resource),
+      bookCompanies(resource),
+      bookCompanyTotals(resource),
+      orderIndex(resource),
+      locations(resource),
+      freeRefs(resource),
+      selection(resource),
+      execution(resource) { }
+
+template<typename IdPolicy, typename StatsPolicy>
+typename BasicOrderCache<IdPolicy, StatsPolicy>::State* BasicOrderCache<IdPolicy, StatsPolicy>::createState()
 {
-  for(auto& pair: mapOrders)
+  void* memory = m_resource->allocate(sizeof(State), alignof(State));
+  return new (memory) State(m_resource);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::destroyState()
+{
+  // everything in an arena goes away with it, running the destructors would
+  // only walk every node to hand memory back to a no-op deallocate; only the
+  // snapshot books live outside it and must be let go
+  if(m_arena)
   {
-    for(std::size_t i = 0; i < pair.second.size(); i++)
+    for(auto& book: m_state->books)
+      book.totals.snapshot.reset();
+    return;
+  }
+
+  m_state->~State();
+  m_resource->deallocate(m_state, sizeof(State), alignof(State));
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+WorkStealingPool& BasicOrderCache<IdPolicy, StatsPolicy>::pool(unsigned int threads)
+{
+  if(!threads)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  if(!m_pool || m_pool->size() != threads)
+    m_pool = std::make_unique<WorkStealingPool>(threads);
+  return *m_pool;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+OrderError BasicOrderCache<IdPolicy, StatsPolicy>::validate(const Order& order)
+{
+  return validateFields(order.m_orderId, order.m_securityId, order.m_side, order.m_qty, order.m_user
+    , order.m_company);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+OrderError BasicOrderCache<IdPolicy, StatsPolicy>::validateFields(std::string_view orderId, std::string_view securityId, std::string_view side
+  , unsigned int qty, std::string_view user, std::string_view company)
+{
+  if(orderId.empty())
+    return OrderError::EmptyOrderId;
+  if(orderId.size() > IdPolicy::MAX_SIZE)
+    return OrderError::OrderIdTooLong;
+  if(securityId.empty())
+    return OrderError::EmptySecurityId;
+  if(user.empty())
+    return OrderError::EmptyUser;
+  if(company.empty())
+    return OrderError::EmptyCompany;
+  if(side.empty())
+    return OrderError::EmptySide;
+  if(!qty)
+    return OrderError::ZeroQty;
+  if(side != BUY && side != SELL)
+    return OrderError::InvalidSide;
+  return OrderError::None;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+OrderError BasicOrderCache<IdPolicy, StatsPolicy>::addOrderFields(std::string_view orderId, std::string_view securityId, Side side
+  , unsigned int qty, std::string_view user, std::string_view company)
+{
+  if(m_book)
+    materialize();
+
+  OrderError error = validateFields(orderId, securityId, sideName(side), qty, user, company);
+  if(error != OrderError::None)
+    return error;
+  OrderRef ref = insertOrderId(orderId);
+  if(ref == NO_REF)
+    return OrderError::DuplicateOrderId;
+  if(m_journal)
+    journalAdd(ref, orderId, securityId, side, qty, user, company);
+  SymbolId userId = internUser(user);
+  insertOrder(ref, internSecurity(securityId), side, qty, userId, m_state->companies.intern(company));
+  m_stats.ordersAdded(1);
+  return OrderError::None;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::cancelOrderId(std::string_view orderId)
+{
+  if(m_book)
+    materialize();
+
+  const OrderRef* ref = findOrderId(orderId);
+  if(!ref)
+    return;
+
+  if(m_journal)
+    m_journal->recordCancel(orderId);
+  erase(*ref);
+  m_stats.ordersCancelled(1);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::throwError(OrderError error)
+{
+  switch(error)
+  {
+    case OrderError::EmptyOrderId:
+      throw std::invalid_argument("Error: order ID is empty!");
+    case OrderError::EmptySecurityId:
+      throw std::invalid_argument("Error: security ID is empty!");
+    case OrderError::EmptyUser:
+      throw std::invalid_argument("Error: user ID is empty!");
+    case OrderError::EmptyCompany:
+      throw std::invalid_argument("Error: company name is empty!");
+    case OrderError::EmptySide:
+      throw std::invalid_argument("Error: side is empty!");
+    case OrderError::ZeroQty:
+      throw std::invalid_argument("Error: qty is zero!");
+    case OrderError::InvalidSide:
+      throw std::invalid_argument("Error:invalid side!");
+    case OrderError::DuplicateOrderId:
+      throw std::runtime_error("Error: order ID have already exist!");
+    case OrderError::MalformedLine:
+      throw std::invalid_argument("Error: malformed order line!");
+    case OrderError::OrderIdTooLong:
+      throw std::invalid_argument("Error: order ID is too long!");
+    default:
+      throw std::logic_error("Error: order has no error!");
+  }
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+Side BasicOrderCache<IdPolicy, StatsPolicy>::parseSide(const std::string& side)
+{
+  if(side == BUY)
+    return Side::Buy;
+  if(side == SELL)
+    return Side::Sell;
+  throwError(OrderError::InvalidSide);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+Order BasicOrderCache<IdPolicy, StatsPolicy>::makeOrder(const OrderView& view)
+{
+  // fills the members directly, the constructor would need std::string copies
+  static const std::string empty;
+  Order order(empty, empty, empty, view.qty, empty, empty);
+  order.m_orderId.assign(view.orderId);
+  order.m_securityId.assign(view.securityId);
+  order.m_side.assign(view.side);
+  order.m_user.assign(view.user);
+  order.m_company.assign(view.company);
+  return order;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+BasicOrderCache<IdPolicy, StatsPolicy>::OrderIterator::OrderIterator(const State* state, SymbolId securityId)
+    : m_state(state),
+      m_securityId(securityId)
+{
+  skipEmpty();
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+OrderView BasicOrderCache<IdPolicy, StatsPolicy>::OrderIterator::operator*() const
+{
+  const SecurityOrders& orders = m_state->books[m_securityId].sides[m_side];
+  return OrderView{ m_state->locations[orders.ref[m_index]].orderId, m_state->securities.name(m_securityId)
+    , sideName(static_cast<Side>(m_side)), orders.qty[m_index]
+    , m_state->users.name(orders.user[m_index]), m_state->companies.name(orders.company[m_index]) };
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+typename BasicOrderCache<IdPolicy, StatsPolicy>::OrderIterator& BasicOrderCache<IdPolicy, StatsPolicy>::OrderIterator::operator++()
+{
+  m_index++;
+  skipEmpty();
+  return *this;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::OrderIterator::skipEmpty()
+{
+  while(m_securityId < m_state->books.size() && m_index >= m_state->books[m_securityId].sides[m_side].size())
+  {
+    m_index = 0;
+    if(++m_side == 2)
     {
-      if(pair.second[i].orderId() != orderId)
+      m_side = 0;
+      m_securityId++;
+    }
+  }
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+typename BasicOrderCache<IdPolicy, StatsPolicy>::OrderRef BasicOrderCache<IdPolicy, StatsPolicy>::allocateRef()
+{
+  if(m_state->freeRefs.empty())
+  {
+    m_state->locations.emplace_back(m_resource);
+    return static_cast<OrderRef>(m_state->locations.size()-1);
+  }
+  OrderRef ref = m_state->freeRefs.back();
+  m_state->freeRefs.pop_back();
+  return ref;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+typename BasicOrderCache<IdPolicy, StatsPolicy>::OrderRef BasicOrderCache<IdPolicy, StatsPolicy>::insertOrderId(std::string_view orderId)
+{
+  // the index key points to the id kept in the location, so the location is
+  // filled first and handed back if the id is a duplicate
+  OrderRef ref = allocateRef();
+  auto& location = m_state->locations[ref];
+  if(!IdPolicy::assign(location.orderId, orderId)
+    || !m_state->orderIndex.tryEmplace(IdPolicy::key(location.orderId), ref).second)
+  {
+    m_state->freeRefs.push_back(ref);
+    return NO_REF;
+  }
+  return ref;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+const typename BasicOrderCache<IdPolicy, StatsPolicy>::OrderRef* BasicOrderCache<IdPolicy, StatsPolicy>::findOrderId(std::string_view orderId) const
+{
+  typename IdPolicy::Key key;
+  if(!IdPolicy::toKey(orderId, key))
+    return nullptr;
+  return m_state->orderIndex.find(key);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+typename BasicOrderCache<IdPolicy, StatsPolicy>::SymbolId BasicOrderCache<IdPolicy, StatsPolicy>::internSecurity(std::string_view securityId)
+{
+  SymbolId id = m_state->securities.intern(securityId);
+  if(id == m_state->books.size())
+    m_state->books.emplace_back(m_resource);
+  return id;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+typename BasicOrderCache<IdPolicy, StatsPolicy>::SymbolId BasicOrderCache<IdPolicy, StatsPolicy>::internUser(std::string_view user)
+{
+  SymbolId id = m_state->users.intern(user);
+  if(id == m_state->userOrders.size())
+    m_state->userOrders.emplace_back();
+  return id;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::materialize()
+{
+  std::unique_ptr<MappedBook> book = std::move(m_book);
+  // the orders inserted below keep the cache's own totals from now on
+  m_state->bookSecurities.clear();
+  m_state->bookCompanies.clear();
+  m_state->bookCompanyTotals.clear();
+
+  // the cache is empty, so the ids normally follow the file's tables; the
+  // maps only guard against a file repeating a name
+  std::vector<SymbolId> securityIds(book->securityCount());
+  for(std::size_t i = 0; i < securityIds.size(); i++)
+    securityIds[i] = internSecurity(book->security(i));
+  std::vector<SymbolId> userIds(book->userCount());
+  for(std::size_t i = 0; i < userIds.size(); i++)
+    userIds[i] = internUser(book->user(i));
+  std::vector<SymbolId> companyIds(book->companyCount());
+  for(std::size_t i = 0; i < companyIds.size(); i++)
+    companyIds[i] = m_state->companies.intern(book->company(i));
+
+  m_state->orderIndex.reserve(book->orderCount());
+  for(std::size_t index = 0; index < securityIds.size(); index++)
+  {
+    const book_file::BookSecurity& run = book->securityRun(index);
+    auto& sides = m_state->books[securityIds[index]].sides;
+    sides[sideIndex(Side::Buy)].reserve(sides[sideIndex(Side::Buy)].size() + run.buyCount);
+    sides[sideIndex(Side::Sell)].reserve(sides[sideIndex(Side::Sell)].size() + run.sellCount);
+    std::size_t sells = run.firstRecord + run.buyCount;
+    for(std::size_t i = run.firstRecord; i < sells + run.sellCount; i++)
+    {
+      OrderRef ref = insertOrderId(book->orderId(i));
+      if(ref == NO_REF)
         continue;
+      const book_file::BookRecord& record = book->record(i);
+      insertOrder(ref, securityIds[index], i < sells ? Side::Buy : Side::Sell, record.qty
+        , userIds[record.user], companyIds[record.company]);
+    }
+  }
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::indexBook()
+{
+  const MappedBook& book = *m_book;
+  m_state->bookSecurities.resize(book.securityCount());
+  for(std::size_t i = 0; i < book.securityCount(); i++)
+    m_state->bookSecurities[i] = internSecurity(book.security(i));
+  std::vector<SymbolId> companyIds(book.companyCount());
+  for(std::size_t i = 0; i < companyIds.size(); i++)
+    companyIds[i] = m_state->companies.intern(book.company(i));
+  m_state->bookCompanyTotals.resize(m_state->companies.size());
 
-      erase(pair.second, i);
-      return true;
+  m_state->bookCompanies.reserve(book.securityCount());
+  for(std::size_t index = 0; index < book.securityCount(); index++)
+  {
+    CompanyQtyMap& companies = m_state->bookCompanies.emplace_back(m_resource);
+    const book_file::BookSecurity& run = book.securityRun(index);
+    std::size_t sells = run.firstRecord + run.buyCount;
+    for(std::size_t i = run.firstRecord; i < sells + run.sellCount; i++)
+    {
+      const book_file::BookRecord& record = book.record(i);
+      SymbolId companyId = companyIds[record.company];
+      CompanyQty& qty = *companies.tryEmplace(companyId, CompanyQty()).first;
+      CompanyQty& overallQty = m_state->bookCompanyTotals[companyId];
+      (i < sells ? qty.buyQty : qty.sellQty) += record.qty;
+      (i < sells ? overallQty.buyQty : overallQty.sellQty) += record.qty;
     }
   }
-  return false;
 }
 
-void OrderCache::cancelOrdersForUser(const std::string& user
-    , MapOrders& mapOrders
-    , OrderIds& orderIds)
+template<typename IdPolicy, typename StatsPolicy>
+const typename BasicOrderCache<IdPolicy, StatsPolicy>::CompanyQtyMap* BasicOrderCache<IdPolicy, StatsPolicy>::companyTotals(const std::string& securityId) const
 {
-  for(auto& pair: mapOrders)
+  if(m_book)
   {
-    for(std::size_t i = 0; i < pair.second.size(); i++)
+    std::uint32_t index = m_book->findSecurity(securityId);
+    return index == book_file::EMPTY_SLOT ? nullptr : &m_state->bookCompanies[index];
+  }
+  SymbolId id = m_state->securities.find(securityId);
+  return id == SymbolTable::npos ? nullptr : &m_state->books[id].totals.companies;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::insertOrder(OrderRef ref, SymbolId securityId, Side side, const Order& order)
+{
+  SymbolId user = internUser(order.m_user);
+  insertOrder(ref, securityId, side, order.m_qty, user, m_state->companies.intern(order.m_company));
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::insertOrder(OrderRef ref, SymbolId securityId, Side side, unsigned int qty, SymbolId user
+  , SymbolId company)
+{
+  auto& book = m_state->books[securityId];
+  auto& orders = book.sides[sideIndex(side)];
+  auto& userOrders = m_state->userOrders[user];
+  auto& location = m_state->locations[ref];
+  location.securityId = securityId;
+  location.side = side;
+  location.index = orders.size();
+  location.userIndex = userOrders.size();
+  auto& bucket = orders.byQty[SecurityOrders::qtyBucket(qty)];
+  location.qtyIndex = bucket.size();
+  bucket.push_back(ref);
+  userOrders.push_back(ref);
+  updateTotals(book.totals, side, company, qty, true);
+  orders.push_back(ref, qty, user, company);
+  m_stats.depth(securityId, book.sides[0].size() + book.sides[1].size());
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::erase(OrderRef ref)
+{
+  const auto& location = m_state->locations[ref];
+  auto& book = m_state->books[location.securityId];
+  auto& orders = book.sides[sideIndex(location.side)];
+  std::size_t index = location.index;
+  eraseUserOrder(orders.user[index], location.userIndex);
+  updateTotals(book.totals, location.side, orders.company[index], orders.qty[index], false);
+  eraseQtyOrder(orders, SecurityOrders::qtyBucket(orders.qty[index]), location.qtyIndex);
+  releaseOrderId(ref);
+  orders.swapRemove(index);
+  if(index < orders.size())
+    m_state->locations[orders.ref[index]].index = index;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::releaseOrderId(OrderRef ref)
+{
+  m_state->orderIndex.erase(IdPolicy::key(m_state->locations[ref].orderId));
+  m_state->freeRefs.push_back(ref);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::journalAdd(OrderRef ref, std::string_view orderId, std::string_view securityId, Side side
+  , unsigned int qty, std::string_view user, std::string_view company)
+{
+  try
+  {
+    m_journal->recordAdd(orderId, securityId, side, qty, user, company);
+  }
+  catch(...)
+  {
+    releaseOrderId(ref);
+    throw;
+  }
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::eraseTail(SecurityBook& book, Side side, std::size_t first, unsigned int minQty)
+{
+  auto& orders = book.sides[sideIndex(side)];
+  std::size_t removed = 0;
+  for(std::size_t bucket = first; bucket < SecurityOrders::QTY_BUCKETS; bucket++)
+  {
+    // the bucket of minQty keeps its smaller orders in their relative order
+    auto& refs = orders.byQty[bucket];
+    std::size_t kept = 0;
+    for(OrderRef ref: refs)
     {
-      if(pair.second[i].user() != user)
+      auto& location = m_state->locations[ref];
+      std::size_t index = location.index;
+      if(orders.qty[index] < minQty)
+      {
+        location.qtyIndex = kept;
+        refs[kept++] = ref;
         continue;
+      }
+      eraseUserOrder(orders.user[index], location.userIndex);
+      updateTotals(book.totals, side, orders.company[index], orders.qty[index], false);
+      releaseOrderId(ref);
+      removed++;
+    }
+    refs.resize(kept);
+  }
+  m_stats.ordersCancelled(removed);
+
+  auto& selection = m_state->selection;
+  selection.resize(orders.size());
+  std::size_t kept = selectLess(orders.qty.data(), orders.size(), minQty, selection.data());
+  orders.compact(selection.data(), kept);
+  for(std::size_t i = 0; i < kept; i++)
+    m_state->locations[orders.ref[i]].index = i;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::eraseQtyOrder(SecurityOrders& orders, std::size_t bucket, std::size_t qtyIndex)
+{
+  auto& refs = orders.byQty[bucket];
+  if(qtyIndex < refs.size()-1)
+  {
+    refs[qtyIndex] = refs.back();
+    m_state->locations[refs[qtyIndex]].qtyIndex = qtyIndex;
+  }
+  refs.pop_back();
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::eraseUserOrder(SymbolId user, std::size_t userIndex)
+{
+  // the list is already detached when all orders of the user are being canceled
+  auto& refs = m_state->userOrders[user];
+  if(refs.empty())
+    return;
+
+  if(userIndex < refs.size()-1)
+  {
+    refs[userIndex] = refs.back();
+    m_state->locations[refs[userIndex]].userIndex = userIndex;
+  }
+  refs.pop_back();
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+std::shared_ptr<const OrderSnapshot::Book> BasicOrderCache<IdPolicy, StatsPolicy>::makeSnapshotBook(SymbolId securityId) const
+{
+  auto book = std::make_shared<OrderSnapshot::Book>();
+  book->securityId = m_state->securities.name(securityId);
+  const auto& sides = m_state->books[securityId].sides;
+  std::size_t count = sides[0].size() + sides[1].size();
+  book->records.reserve(count);
+
+  auto append = [&book](std::string_view name, std::uint32_t& offset, std::uint32_t& size)
+  {
+    offset = static_cast<std::uint32_t>(book->names.size());
+    size = static_cast<std::uint32_t>(name.size());
+    book->names.append(name);
+  };
+  for(Side side: { Side::Buy, Side::Sell })
+  {
+    const auto& orders = sides[sideIndex(side)];
+    for(std::size_t i = 0; i < orders.size(); i++)
+    {
+      OrderSnapshot::Book::Record record;
+      append(m_state->locations[orders.ref[i]].orderId, record.orderId, record.orderIdSize);
+      append(m_state->users.name(orders.user[i]), record.user, record.userSize);
+      append(m_state->companies.name(orders.company[i]), record.company, record.companySize);
+      record.qty = orders.qty[i];
+      record.side = side;
+      book->records.push_back(record);
+    }
+  }
+  return book;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+bool BasicOrderCache<IdPolicy, StatsPolicy>::contains(std::string_view orderId) const
+{
+  return findOrderId(orderId) != nullptr;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+std::size_t BasicOrderCache<IdPolicy, StatsPolicy>::orderCount() const
+{
+  return m_book ? m_book->orderCount() : m_state->orderIndex.size();
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::collectUserOrderIds(std::string_view user, std::vector<std::string>& ids) const
+{
+  SymbolId userId = m_state->users.find(user);
+  if(userId == SymbolTable::npos)
+    return;
+
+  for(OrderRef ref: m_state->userOrders[userId])
+    ids.emplace_back(m_state->locations[ref].orderId);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::collectMinimumQtyOrderIds(std::string_view securityId, unsigned int minQty
+  , std::vector<std::string>& ids) const
+{
+  SymbolId id = m_state->securities.find(securityId);
+  if(id == SymbolTable::npos)
+    return;
+
+  for(const auto& orders: m_state->books[id].sides)
+  {
+    for(std::size_t bucket = SecurityOrders::qtyBucket(minQty); bucket < SecurityOrders::QTY_BUCKETS; bucket++)
+    {
+      for(OrderRef ref: orders.byQty[bucket])
+      {
+        const auto& location = m_state->locations[ref];
+        if(orders.qty[location.index] >= minQty)
+          ids.emplace_back(location.orderId);
+      }
+    }
+  }
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+bool BasicOrderCache<IdPolicy, StatsPolicy>::cachedMatchingSize(std::string_view securityId, unsigned int& size) const
+{
+  SymbolId id = m_state->securities.find(securityId);
+  if(id == SymbolTable::npos)
+  {
+    size = 0;
+    return true;
+  }
+  const auto& totals = m_state->books[id].totals;
+  size = totals.matchingSize;
+  return !totals.dirty;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+unsigned int BasicOrderCache<IdPolicy, StatsPolicy>::matchingSize(SecurityTotals& totals)
+{
+  if(!totals.dirty)
+    return totals.matchingSize;
+
+  totals.matchingSize = computeMatchingSize(totals);
+  totals.dirty = false;
+  return totals.matchingSize;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+unsigned int BasicOrderCache<IdPolicy, StatsPolicy>::computeMatchingSize(const SecurityTotals& totals)
+{
+  return static_cast<unsigned int>(std::min<unsigned long long>(maxMatchingQty(totals)
+    , std::numeric_limits<unsigned int>::max()));
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+unsigned long long BasicOrderCache<IdPolicy, StatsPolicy>::maxMatchingQty(const SecurityTotals& totals)
+{
+  // Max flow of the buy/sell graph aggregated by company: either a whole side
+  // is exhausted, or every order outside one company is fully matched and the
+  // rest are that company's own buys and sells, which cannot trade together.
+  unsigned long long totalQty = std::min(totals.buyQty, totals.sellQty);
+  totals.companies.forEach([&](SymbolId, const CompanyQty& company) {
+    totalQty = std::min(totalQty, totals.buyQty + totals.sellQty - company.buyQty - company.sellQty);
+  });
+  return totalQty;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+unsigned long long BasicOrderCache<IdPolicy, StatsPolicy>::executeSecurity(std::string_view securityId, FillSink& sink)
+{
+  if(m_book)
+    materialize();
+
+  SymbolId id = m_state->securities.find(securityId);
+  if(id == SymbolTable::npos)
+    return 0;
+  auto& book = m_state->books[id];
+  unsigned long long executed = maxMatchingQty(book.totals);
+  if(!executed)
+    return 0;
+
+  auto& execution = m_state->execution;
+  planExecution(book.totals, executed);
+  queuePortions(book.sides[sideIndex(Side::Buy)], Side::Buy);
+  queuePortions(book.sides[sideIndex(Side::Sell)], Side::Sell);
+  pairPortions(executed);
 
-      orderIds.erase(pair.second[i].orderId());
-      erase(pair.second, i);
+  // the ids are handed out before any order is removed; the journal takes
+  // the fills too, replaying them does not depend on the book layout
+  const auto& buys = book.sides[sideIndex(Side::Buy)];
+  const auto& sells = book.sides[sideIndex(Side::Sell)];
+  for(const auto& fill: execution.fills)
+  {
+    std::string_view buyId = m_state->locations[buys.ref[fill.buy]].orderId;
+    std::string_view sellId = m_state->locations[sells.ref[fill.sell]].orderId;
+    sink.fill(buyId, sellId, fill.qty);
+    if(m_journal)
+      m_journal->recordFill(buyId, sellId, fill.qty);
+  }
+
+  execution.filled.clear();
+  applyPortions(book, Side::Buy);
+  applyPortions(book, Side::Sell);
+  for(OrderRef ref: execution.filled)
+    erase(ref);
+  m_stats.ordersFilled(execution.filled.size());
+  m_stats.executed(executed);
+  return executed;
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::applyFill(std::string_view buyOrderId, std::string_view sellOrderId, unsigned int qty)
+{
+  if(m_book)
+    materialize();
+
+  if(m_journal)
+    m_journal->recordFill(buyOrderId, sellOrderId, qty);
+  reduceOrder(buyOrderId, qty);
+  reduceOrder(sellOrderId, qty);
+  m_stats.executed(qty);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::reduceOrder(std::string_view orderId, unsigned int qty)
+{
+  const OrderRef* ref = findOrderId(orderId);
+  if(!ref)
+    return;
+
+  const auto& location = m_state->locations[*ref];
+  auto& book = m_state->books[location.securityId];
+  if(qty < book.sides[sideIndex(location.side)].qty[location.index])
+  {
+    reduceQty(book, location.side, location.index, qty);
+    return;
+  }
+  erase(*ref);
+  m_stats.ordersFilled(1);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::planExecution(const SecurityTotals& totals, unsigned long long executed)
+{
+  auto& companies = m_state->execution.companies;
+  companies.clear();
+  std::size_t dominant = 0;
+  unsigned long long dominantQty = 0;
+  totals.companies.forEach([&](SymbolId company, const CompanyQty& qty) {
+    if(qty.buyQty + qty.sellQty > dominantQty)
+    {
+      dominant = companies.size();
+      dominantQty = qty.buyQty + qty.sellQty;
     }
+    companies.push_back({ company, qty.buyQty, qty.sellQty });
+  });
+
+  // when the company with the most qty bounds the matching size, every other
+  // order trades in full against that company
+  if(totals.buyQty + totals.sellQty - dominantQty == executed)
+  {
+    auto& company = companies[dominant];
+    unsigned long long buyQty = totals.sellQty - company.sellQty;
+    company.sellQty = totals.buyQty - company.buyQty;
+    company.buyQty = buyQty;
+    return;
+  }
+
+  // otherwise the smaller side trades in full, and every company takes from
+  // the larger side at most what the other companies can match
+  bool buysInFull = totals.buyQty == executed;
+  unsigned long long left = executed;
+  for(auto& company: companies)
+  {
+    unsigned long long full = buysInFull ? company.buyQty : company.sellQty;
+    unsigned long long& capped = buysInFull ? company.sellQty : company.buyQty;
+    capped = std::min({ capped, executed - full, left });
+    left -= capped;
   }
 }
 
-void OrderCache::cancelOrdersForSecIdWithMinimumQty(const std::string& securityId
-  , unsigned int minQty
-  , MapOrders& mapOrders
-  , OrderIds& orderIds)
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::queuePortions(const SecurityOrders& orders, Side side)
 {
-  auto& vec = mapOrders[securityId];
-  for(std::size_t i = 0; i < vec.size(); i++)
+  auto& execution = m_state->execution;
+  auto& companies = execution.companies;
+  auto& slots = execution.companySlots;
+  slots.resize(m_state->companies.size());
+  for(std::size_t slot = 0; slot < companies.size(); slot++)
+    slots[companies[slot].company] = static_cast<std::uint32_t>(slot);
+
+  // counting sort by company keeps book order within each company
+  auto& offsets = execution.offsets;
+  offsets.assign(companies.size() + 1, 0);
+  for(std::size_t i = 0; i < orders.size(); i++)
+    offsets[slots[orders.company[i]] + 1]++;
+  for(std::size_t slot = 0; slot < companies.size(); slot++)
+    offsets[slot + 1] += offsets[slot];
+  auto& queue = execution.queue;
+  queue.resize(orders.size());
+  for(std::size_t i = 0; i < orders.size(); i++)
+    queue[offsets[slots[orders.company[i]]]++] = static_cast<std::uint32_t>(i);
+
+  // offsets[slot] is now the end of the slot's orders and the start of the next slot's
+  auto& portions = side == Side::Buy ? execution.buys : execution.sells;
+  portions.clear();
+  unsigned long long offset = 0;
+  for(std::size_t k = 0; k < companies.size(); k++)
   {
-    if(vec[i].qty() < minQty)
+    std::size_t slot = side == Side::Buy ? k : companies.size() - 1 - k;
+    unsigned long long qty = side == Side::Buy ? companies[slot].buyQty : companies[slot].sellQty;
+    for(std::size_t i = slot ? offsets[slot - 1] : 0; qty; i++)
+    {
+      unsigned int taken = static_cast<unsigned int>(std::min<unsigned long long>(orders.qty[queue[i]], qty));
+      portions.push_back({ queue[i], taken, offset });
+      offset += taken;
+      qty -= taken;
+    }
+  }
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::pairPortions(unsigned long long executed)
+{
+  // Buys are laid out company by company and sells in the reverse company
+  // order, both over [0, executed), and the qty at the same offset pairs up.
+  // A company only meets itself if its buys and sells together straddle
+  // offset executed in the combined layout, which at most one company does.
+  // Its overlap is swapped with offsets where neither side is that company;
+  // there are enough since no company executes more than executed in all.
+  auto& execution = m_state->execution;
+  execution.fills.clear();
+  unsigned long long buyStart = 0, sellEnd = executed;
+  for(const auto& company: execution.companies)
+  {
+    unsigned long long total = buyStart + (executed - sellEnd);
+    if(total < executed && executed < total + company.buyQty + company.sellQty)
+    {
+      unsigned long long buyEnd = buyStart + company.buyQty;
+      unsigned long long sellStart = sellEnd - company.sellQty;
+      unsigned long long overlapStart = std::max(buyStart, sellStart);
+      unsigned long long overlapEnd = std::min(buyEnd, sellEnd);
+      unsigned long long overlap = overlapEnd - overlapStart;
+      unsigned long long usedStart = std::min(buyStart, sellStart);
+      unsigned long long usedEnd = std::max(buyEnd, sellEnd);
+      // free offsets are taken below usedStart first, then from usedEnd on
+      unsigned long long low = std::min(usedStart, overlap);
+      unsigned long long high = overlap - low;
+
+      pairRange(low, low, overlapStart - low);
+      pairRange(overlapEnd, overlapEnd, usedEnd - overlapEnd);
+      pairRange(usedEnd + high, usedEnd + high, executed - usedEnd - high);
+      pairRange(0, overlapStart, low);
+      pairRange(overlapStart, 0, low);
+      pairRange(usedEnd, overlapStart + low, high);
+      pairRange(overlapStart + low, usedEnd, high);
+      return;
+    }
+    buyStart += company.buyQty;
+    sellEnd -= company.sellQty;
+  }
+  pairRange(0, 0, executed);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::pairRange(unsigned long long buyOffset, unsigned long long sellOffset, unsigned long long qty)
+{
+  if(!qty)
+    return;
+
+  auto& execution = m_state->execution;
+  auto startingAt = [](const std::pmr::vector<typename Execution::Portion>& portions, unsigned long long offset) {
+    auto it = std::upper_bound(portions.begin(), portions.end(), offset
+      , [](unsigned long long value, const typename Execution::Portion& portion) { return value < portion.offset; });
+    return static_cast<std::size_t>(it - portions.begin()) - 1;
+  };
+  std::size_t buy = startingAt(execution.buys, buyOffset);
+  std::size_t sell = startingAt(execution.sells, sellOffset);
+  while(qty)
+  {
+    const auto& buyPortion = execution.buys[buy];
+    const auto& sellPortion = execution.sells[sell];
+    unsigned long long buyLeft = buyPortion.offset + buyPortion.qty - buyOffset;
+    unsigned long long sellLeft = sellPortion.offset + sellPortion.qty - sellOffset;
+    unsigned int taken = static_cast<unsigned int>(std::min({ buyLeft, sellLeft, qty }));
+
+    // ranges next to each other may continue the same pair of orders
+    auto& fills = execution.fills;
+    if(!fills.empty() && fills.back().buy == buyPortion.index && fills.back().sell == sellPortion.index)
+      fills.back().qty += taken;
+    else
+      fills.push_back({ buyPortion.index, sellPortion.index, taken });
+
+    buyOffset += taken;
+    sellOffset += taken;
+    qty -= taken;
+    if(taken == buyLeft)
+      buy++;
+    if(taken == sellLeft)
+      sell++;
+  }
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::applyPortions(SecurityBook& book, Side side)
+{
+  auto& execution = m_state->execution;
+  auto& orders = book.sides[sideIndex(side)];
+  for(const auto& portion: side == Side::Buy ? execution.buys : execution.sells)
+  {
+    OrderRef ref = orders.ref[portion.index];
+    if(portion.qty == orders.qty[portion.index])
+    {
+      execution.filled.push_back(ref);
       continue;
+    }
 
-    orderIds.erase(vec[i].orderId());
-    erase(vec, i);
+    reduceQty(book, side, portion.index, portion.qty);
   }
 }
 
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::reduceQty(SecurityBook& book, Side side, std::size_t index, unsigned int qty)
+{
+  // the order moves to the bucket of its new qty if that is a smaller one
+  auto& orders = book.sides[sideIndex(side)];
+  auto& location = m_state->locations[orders.ref[index]];
+  std::size_t bucket = SecurityOrders::qtyBucket(orders.qty[index]);
+  orders.qty[index] -= qty;
+  std::size_t newBucket = SecurityOrders::qtyBucket(orders.qty[index]);
+  if(newBucket != bucket)
+  {
+    eraseQtyOrder(orders, bucket, location.qtyIndex);
+    location.qtyIndex = orders.byQty[newBucket].size();
+    orders.byQty[newBucket].push_back(orders.ref[index]);
+  }
+  updateTotals(book.totals, side, orders.company[index], qty, false);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::updateTotals(SecurityTotals& totals, Side side, SymbolId companyId, unsigned int qty, bool isAdd)
+{
+  auto& company = *totals.companies.tryEmplace(companyId, CompanyQty()).first;
+  auto& totalQty = side == Side::Buy ? totals.buyQty : totals.sellQty;
+  auto& companyQty = side == Side::Buy ? company.buyQty : company.sellQty;
+  auto& companyTotals = m_state->companyTotals;
+  if(companyId >= companyTotals.size())
+    companyTotals.resize(companyId + 1);
+  auto& overallQty = side == Side::Buy ? companyTotals[companyId].buyQty : companyTotals[companyId].sellQty;
+  totals.dirty = true;
+  totals.snapshot.reset();
+  if(isAdd)
+  {
+    totalQty += qty;
+    companyQty += qty;
+    overallQty += qty;
+    return;
+  }
+
+  totalQty -= qty;
+  companyQty -= qty;
+  overallQty -= qty;
+  if(!company.buyQty && !company.sellQty)
+    totals.companies.erase(companyId);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::SecurityOrders::push_back(OrderRef orderRef, unsigned int orderQty, SymbolId orderUser
+  , SymbolId orderCompany)
+{
+  qty.push_back(orderQty);
+  company.push_back(orderCompany);
+  user.push_back(orderUser);
+  ref.push_back(orderRef);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::SecurityOrders::swapRemove(std::size_t index)
+{
+  std::size_t last = size()-1;
+  if(index < last)
+  {
+    qty[index] = qty[last];
+    company[index] = company[last];
+    user[index] = user[last];
+    ref[index] = ref[last];
+  }
+  qty.pop_back();
+  company.pop_back();
+  user.pop_back();
+  ref.pop_back();
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::SecurityOrders::reserve(std::size_t count)
+{
+  qty.reserve(count);
+  company.reserve(count);
+  user.reserve(count);
+  ref.reserve(count);
+}
+
+template<typename IdPolicy, typename StatsPolicy>
+void BasicOrderCache<IdPolicy, StatsPolicy>::SecurityOrders::compact(const std::uint32_t* sel, std::size_t count)
+{
+  compactColumn(qty, sel, count);
+  compactColumn(company, sel, count);
+  compactColumn(user, sel, count);
+  compactColumn(ref, sel, count);
+}
+
+// the order id and stats policies the cache is built for, declared in OrderCache.h
+template class BasicOrderCache<StringOrderIds, CollectStats>;
+template class BasicOrderCache<StringOrderIds, NoStats>;
+template class BasicOrderCache<FixedOrderIds<16>, CollectStats>;
+template class BasicOrderCache<FixedOrderIds<16>, NoStats>;
+
+////------------------------  OrderSnapshot -------------------------------------
+
+std::vector<Order> OrderSnapshot::getAllOrders() const
+{
+  std::vector<Order> orders;
+  orders.reserve(m_size);
+  forEachOrder([&orders](const OrderView& order) {
+    orders.push_back(OrderCache::makeOrder(order));
+  });
+  return orders;
+}
+
+std::size_t OrderSnapshot::memoryBytes() const
+{
+  std::size_t bytes = 0;
+  for(const auto& book: m_books)
+    bytes += book->bytes();
+  return bytes;
+}
+
+std::size_t OrderSnapshot::exclusiveBytes() const
+{
+  std::size_t bytes = 0;
+  for(const auto& book: m_books)
+  {
+    if(book.use_count() == 1)
+      bytes += book->bytes();
+  }
+  return bytes;
+}
+
+std::size_t OrderSnapshot::Book::bytes() const
+{
+  return sizeof(Book) + securityId.capacity() + names.capacity() + records.capacity() * sizeof(Record);
+}
+
+////------------------------  SymbolTable ---------------------------------------
+
+SymbolTable::Id SymbolTable::intern(std::string_view name)
+{
+  if(const Id* id = m_ids.find(name))
+    return *id;
+
+  m_names.emplace_back(name);
+  return *m_ids.tryEmplace(m_names.back(), static_cast<Id>(m_names.size()-1)).first;
+}
+
+SymbolTable::Id SymbolTable::find(std::string_view name) const
+{
+  const Id* id = m_ids.find(name);
+  return id ? *id : npos;
+}
+
 /******************************   MY RESULT   ******************************
 [==========] Running 46 tests from 1 test suite.
 [----------] Global test environment set-up.
@@ -1,9 +1,19 @@
 #pragma once
 
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
-#include <unordered_set>
+#include "BookFile.h"
+#include "FlatHashMap.h"
+#include "OrderCacheStats.h"
+#include "OrderIdPolicy.h"
+
+template<typename IdPolicy, typename StatsPolicy> class BasicOrderCache;
 
 class Order
 {
@@ -35,6 +45,10 @@ class Order
 
  private:
 
+  // lets the caches read and move the members without the accessor copies
+  template<typename IdPolicy, typename StatsPolicy> friend class BasicOrderCache;
+  friend class ConcurrentOrderCache;
+
   // use the below to hold the order data
   // do not remove the these member variables
   std::string m_orderId;     // unique order id
@@ -46,13 +60,150 @@ class Order
 
 };
 
-struct OrderExpander : public Order
+enum class Side : unsigned char
+{
+  Buy,
+  Sell
+};
+
+inline std::string_view sideName(Side side) { return side == Side::Buy ? "Buy" : "Sell"; }
+
+// reason an order is rejected by the cache
+enum class OrderError : unsigned char
+{
+  None,
+  EmptyOrderId,
+  EmptySecurityId,
+  EmptyUser,
+  EmptyCompany,
+  EmptySide,
+  ZeroQty,
+  InvalidSide,
+  DuplicateOrderId,
+  MalformedLine,
+  OrderIdTooLong
+};
+
+// order of a batch that was not added, by position in the batch
+struct BatchError
+{
+  std::size_t index;
+  OrderError error;
+};
+
+// read-only record of a resting order; the views point into the cache and
+// stay valid until the cache is next modified
+struct OrderView
+{
+  std::string_view orderId;
+  std::string_view securityId;
+  std::string_view side;
+  unsigned int qty;
+  std::string_view user;
+  std::string_view company;
+};
+
+// matching size of one security, as returned for all securities at once
+struct SecurityMatchingSize
+{
+  std::string_view securityId;
+  unsigned int matchingSize;
+};
+
+// open qty of a company, in one security or over all of them; the name
+// points into the cache and stays valid until clear()
+struct CompanyExposure
+{
+  std::string_view company;
+  unsigned long long buyQty;
+  unsigned long long sellQty;
+};
+
+class WorkStealingPool;
+class OrderJournal;
+class FillSink;
+
+// Point-in-time, read-only copy of the orders of a cache. Every security is
+// an immutable book shared by all snapshots taken while the security did not
+// change, so a snapshot copies only the securities changed since the last
+// one. Books own their strings: a snapshot can be read from any thread while
+// the cache keeps changing, and outlives the cache.
+class OrderSnapshot
+{
+ public:
+  OrderSnapshot() = default;
+
+  // visits the orders grouped by security and side, like the cache does
+  template<typename Visitor>
+  void forEachOrder(Visitor&& visitor) const;
+
+  std::vector<Order> getAllOrders() const;
+
+  std::size_t size() const { return m_size; }
+
+  // heap bytes of all the books of the snapshot
+  std::size_t memoryBytes() const;
+
+  // heap bytes of the books held by this snapshot alone, which is what
+  // keeping it alive costs once the cache and other snapshots moved on;
+  // approximate while other threads take or drop snapshots
+  std::size_t exclusiveBytes() const;
+
+ private:
+   template<typename IdPolicy, typename StatsPolicy> friend class BasicOrderCache;
+   friend class ConcurrentOrderCache;
+
+   // the orders of one security, strings back to back in names
+   struct Book
+   {
+     struct Record
+     {
+       std::uint32_t orderId;
+       std::uint32_t orderIdSize;
+       std::uint32_t user;
+       std::uint32_t userSize;
+       std::uint32_t company;
+       std::uint32_t companySize;
+       unsigned int qty;
+       Side side;
+     };
+
+     std::string securityId;
+     std::string names;
+     std::vector<Record> records;
+
+     std::size_t bytes() const;
+   };
+
+   std::vector<std::shared_ptr<const Book>> m_books;
+   std::size_t m_size = 0;
+};
+
+// Maps names (securities, users, companies) to dense ids. Ids are never
+// reused and the names live as long as the table, so lookups by string_view
+// need no allocation.
+class SymbolTable
 {
-   OrderExpander(Order& order)
-      : Order(std::move(order))
-      , currentQty(qty()) { }
+ public:
+  using Id = unsigned int;
+  static constexpr Id npos = ~Id(0);
+
+  explicit SymbolTable(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : m_names(resource),
+        m_ids(resource) { }
+
+  // returns the id of the name, adding it if it is new
+  Id intern(std::string_view name);
+
+  // returns the id of the name or npos
+  Id find(std::string_view name) const;
 
-   unsigned int currentQty;
+  std::string_view name(Id id) const { return m_names[id]; }
+  std::size_t size() const           { return m_names.size(); }
+
+ private:
+  std::pmr::deque<std::pmr::string> m_names;  // deque keeps the keys of m_ids in place
+  FlatHashMap<std::string_view, Id> m_ids;
 };
 
 // Provide an implementation for the OrderCacheInterface interface class.
@@ -86,15 +237,208 @@ class OrderCacheInterface
 };
 
 // Todo: Your implementation of the OrderCache...
-class OrderCache : public OrderCacheInterface
+// IdPolicy selects how order ids are stored and indexed, see OrderIdPolicy.h;
+// StatsPolicy whether the cache times its calls and counts its changes,
+// CollectStats or NoStats, see OrderCacheStats.h. The members are defined in
+// OrderCache.cpp, which instantiates the cache for the policies declared
+// extern below; OrderCache is the one with string ids and stats, which the
+// journal, the ingest queue and ConcurrentOrderCache work on
+template<typename IdPolicy = StringOrderIds, typename StatsPolicy = CollectStats>
+class BasicOrderCache : public OrderCacheInterface
 {
-  using MapOrders = std::unordered_map<std::string, std::vector<OrderExpander>>;  
-  using OrderIds = std::unordered_set<std::string>;
+  // stable handle of a resting order, reused after the order is removed
+  using OrderRef = unsigned int;
+  static constexpr OrderRef NO_REF = ~OrderRef(0);
+  using SymbolId = SymbolTable::Id;
+  using Resource = std::pmr::memory_resource;
+
+  // orders of one security on one side stored as parallel columns, so a pass
+  // over qty or company loads only that column; the order id is cold and kept
+  // in the order location
+  struct SecurityOrders
+  {
+    // the orders are also bucketed by the bit width of their qty: a minimum
+    // qty cancel takes every bucket above the one of minQty and filters only
+    // that one, while an add or cancel is a push or swap-remove in a bucket
+    static constexpr std::size_t QTY_BUCKETS = 32;
+
+    explicit SecurityOrders(Resource* resource)
+        : qty(resource), company(resource), user(resource), ref(resource), byQty(QTY_BUCKETS, resource) { }
+
+    std::pmr::vector<unsigned int> qty;
+    std::pmr::vector<SymbolId> company;
+    std::pmr::vector<SymbolId> user;
+    std::pmr::vector<OrderRef> ref;
+    std::pmr::vector<std::pmr::vector<OrderRef>> byQty;  // by qtyBucket()
+
+    static std::size_t qtyBucket(unsigned int orderQty)
+    {
+      return 31 - static_cast<std::size_t>(__builtin_clz(orderQty));
+    }
+
+    std::size_t size() const { return qty.size(); }
+
+    void push_back(OrderRef orderRef, unsigned int orderQty, SymbolId orderUser, SymbolId orderCompany);
+
+    // moves the last order into index and drops the last slot
+    void swapRemove(std::size_t index);
+
+    // keeps only the orders at the ascending positions in sel
+    void compact(const std::uint32_t* sel, std::size_t count);
+
+    void reserve(std::size_t count);
+  };
+
+  // open qty of one company in one security
+  struct CompanyQty
+  {
+    unsigned long long buyQty = 0;
+    unsigned long long sellQty = 0;
+  };
+  using CompanyQtyMap = FlatHashMap<SymbolId, CompanyQty, IntegerHash>;
+
+  // running totals of a security, the matching size is derived from them and
+  // cached until the next add or cancel marks it dirty
+  struct SecurityTotals
+  {
+    explicit SecurityTotals(Resource* resource)
+        : companies(resource) { }
+
+    unsigned long long buyQty = 0;
+    unsigned long long sellQty = 0;
+    CompanyQtyMap companies;
+    unsigned int matchingSize = 0;
+    bool dirty = true;
+    // book handed to snapshots until the next change, it lives on the heap
+    // since snapshots may outlive the cache and its memory resource
+    std::shared_ptr<const OrderSnapshot::Book> snapshot;
+  };
+
+  // everything kept for one security, indexed by its symbol id
+  struct SecurityBook
+  {
+    explicit SecurityBook(Resource* resource)
+        : sides{ SecurityOrders(resource), SecurityOrders(resource) }, totals(resource) { }
+
+    // a copy would allocate from the default resource, so vector growth must move
+    SecurityBook(const SecurityBook&) = delete;
+    SecurityBook(SecurityBook&&) = default;
+
+    SecurityOrders sides[2];  // indexed by Side
+    SecurityTotals totals;
+  };
+
+  // where a resting order lives: security book, side and slot in it, plus
+  // its slot in the owner's list of the user index and in its qty bucket;
+  // with StringOrderIds the order id string is also the storage the order
+  // index keys point to, with FixedOrderIds the location is trivially copyable
+  struct OrderLocation
+  {
+    explicit OrderLocation(Resource* resource)
+        : orderId(IdPolicy::make(resource)) { }
+
+    SymbolId securityId = 0;
+    Side side = Side::Buy;
+    std::size_t index = 0;
+    std::size_t userIndex = 0;
+    std::size_t qtyIndex = 0;
+    typename IdPolicy::Storage orderId;
+  };
+  using OrderIndex = FlatHashMap<typename IdPolicy::Key, OrderRef>;
+
+  // scratch of executeMatches(), kept in the state to reuse its capacity
+  struct Execution
+  {
+    // qty one company executes on each side
+    struct Company
+    {
+      SymbolId company;
+      unsigned long long buyQty;
+      unsigned long long sellQty;
+    };
+    // qty taken from the order at a column index, and the qty taken before
+    // it on the side
+    struct Portion
+    {
+      std::uint32_t index;
+      unsigned int qty;
+      unsigned long long offset;
+    };
+    // by column indexes of the buy and sell side
+    struct Fill
+    {
+      std::uint32_t buy;
+      std::uint32_t sell;
+      unsigned int qty;
+    };
+
+    explicit Execution(Resource* resource)
+        : companySlots(resource), companies(resource), offsets(resource), queue(resource), buys(resource)
+        , sells(resource), fills(resource), filled(resource) { }
+
+    std::pmr::vector<std::uint32_t> companySlots;  // by company id, its slot in companies
+    std::pmr::vector<Company> companies;
+    std::pmr::vector<std::uint32_t> offsets;       // per slot, bounds of its orders in queue
+    std::pmr::vector<std::uint32_t> queue;         // column indexes grouped by company
+    std::pmr::vector<Portion> buys;
+    std::pmr::vector<Portion> sells;
+    std::pmr::vector<Fill> fills;
+    std::pmr::vector<OrderRef> filled;             // orders filled in full
+  };
+
+  // all containers of the cache, allocated from one memory resource
+  struct State
+  {
+    explicit State(Resource* resource);
+
+    SymbolTable securities;
+    SymbolTable users;
+    SymbolTable companies;
+    std::pmr::vector<SecurityBook> books;                     // by security id
+    std::pmr::vector<std::pmr::vector<OrderRef>> userOrders;  // by user id
+    std::pmr::vector<CompanyQty> companyTotals;               // by company id, over all securities
+    std::pmr::vector<SymbolId> bookSecurities;                // ids of the securities of a loaded book, until materialize()
+    std::pmr::vector<CompanyQtyMap> bookCompanies;            // by security of a loaded book, likewise
+    std::pmr::vector<CompanyQty> bookCompanyTotals;           // by company id, likewise
+    OrderIndex orderIndex;
+    std::pmr::deque<OrderLocation> locations;                 // by order ref
+    std::pmr::vector<OrderRef> freeRefs;
+    std::pmr::vector<std::uint32_t> selection;                // scratch for bulk cancels
+    Execution execution;
+  };
 
  public:
 
+  // selects the arena mode: everything is allocated from a monotonic arena
+  // owned by the cache, which clear() resets at once
+  struct Arena
+  {
+    std::size_t initialSize = 1 << 20;
+  };
+
+  // all internal containers and strings allocate from resource
+  explicit BasicOrderCache(Resource* resource = std::pmr::get_default_resource());
+
+  explicit BasicOrderCache(Arena arena);
+
+  ~BasicOrderCache();
+
+  BasicOrderCache(const BasicOrderCache&) = delete;
+  BasicOrderCache& operator=(const BasicOrderCache&) = delete;
+
   void addOrder(Order order) override;
 
+  // addOrder() on views of the fields, for callers holding them in their own
+  // buffers: neither an Order nor any std::string is built, so an add only
+  // allocates storage the cache keeps for the order
+  void emplaceOrder(std::string_view orderId, std::string_view securityId, std::string_view side, unsigned int qty
+    , std::string_view user, std::string_view company);
+
+  // adds the valid orders of the batch and reports the others by position,
+  // sorted by position, instead of throwing; a duplicate id within the batch
+  // is rejected after its first occurrence
+  std::vector<BatchError> addOrders(std::vector<Order>&& orders);
+
   void cancelOrder(const std::string& orderId) override;
 
   void cancelOrdersForUser(const std::string& user) override;
@@ -105,22 +449,329 @@ class OrderCache : public OrderCacheInterface
 
   std::vector<Order> getAllOrders() const override;
 
+  // executes the matches getMatchingSizeForSecurity() counts: streams every
+  // fill to sink as it is found, removes the orders filled in full, reduces
+  // the qty of the others and returns the qty executed. The orders of a
+  // company are queued in book order and filled from the front; no fill is
+  // between two orders of the same company. Runs in O(buys + sells + fills)
+  unsigned long long executeMatches(const std::string& securityId, FillSink& sink);
+
+  // open buy and sell qty of the company in the security, zero with an
+  // empty name when either is unknown; O(1) from the totals the cache keeps
+  // on add, cancel and execute, or from those loadBook() sums for the book
+  CompanyExposure getCompanyExposure(const std::string& securityId, const std::string& company);
+
+  // open buy and sell qty of the company over all securities, O(1)
+  CompanyExposure getCompanyExposure(const std::string& company);
+
+  // open qty of every company with orders in the security, in no particular
+  // order; O(companies in the security)
+  std::vector<CompanyExposure> getCompanyExposures(const std::string& securityId);
+
+  // matching size of every security known to the cache, indexed in the
+  // order the securities were first added; securities are spread over a
+  // work-stealing pool of threads, all hardware threads when threads is 0
+  std::vector<SecurityMatchingSize> getMatchingSizeForAllSecurities(unsigned int threads = 0);
+
+  // writes the orders to a book file, see BookFile.h
+  void saveBook(const std::string& path);
+
+  // replaces the orders with those of a book file, which is mapped and
+  // serves getAllOrders(), forEachOrder() and the matching sizes in place;
+  // the company exposures are summed once from its records, in O(orders).
+  // Any other call copies the book into the cache first
+  void loadBook(const std::string& path);
+
+  // adds the orders of a text order file, see OrderFile.h, and reports the
+  // lines that were not added by zero-based line number, like addOrders();
+  // the file is mapped and parsed in chunks on a work-stealing pool of
+  // threads, all hardware threads when threads is 0, while the orders are
+  // added on the calling thread in file order. Throws std::runtime_error if
+  // the file cannot be opened
+  std::vector<BatchError> loadOrderFile(const std::string& path, unsigned int threads = 0);
+
+  // records every later change in the journal before applying it, nullptr
+  // stops recording; a change the journal rejects throws std::runtime_error
+  // and leaves the cache unchanged. The journal must outlive its use by the
+  // cache
+  void setJournal(OrderJournal* journal) { m_journal = journal; }
+
+  // latency histograms of the public methods, counters and book depths, see
+  // OrderCacheStats.h; empty with NoStats
+  OrderCacheStats stats() const;
+
+  // true while the orders are served from a loaded book file
+  bool isMapped() const { return m_book != nullptr; }
+
+  // removes all orders; in arena mode the arena is released without visiting
+  // the orders
+  void clear();
+
+  // visits every resting order as an OrderView without allocating, grouped
+  // by security and side
+  template<typename Visitor>
+  void forEachOrder(Visitor&& visitor) const;
+
+  // forward iteration over the resting orders in the order forEachOrder()
+  // visits them; any change to the cache invalidates the iterators
+  class OrderIterator
+  {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = OrderView;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = OrderView;
+
+    OrderIterator() = default;
+
+    OrderView operator*() const;
+
+    OrderIterator& operator++();
+    OrderIterator operator++(int) { OrderIterator it = *this; ++*this; return it; }
+
+    bool operator==(const OrderIterator& other) const
+    {
+      return m_securityId == other.m_securityId && m_side == other.m_side && m_index == other.m_index;
+    }
+    bool operator!=(const OrderIterator& other) const { return !(*this == other); }
+
+   private:
+    friend class BasicOrderCache;
+    OrderIterator(const State* state, SymbolId securityId);
+
+    // moves forward to the next non-empty side, or to the end
+    void skipEmpty();
+
+    const State* m_state = nullptr;
+    SymbolId m_securityId = 0;
+    unsigned int m_side = 0;
+    std::size_t m_index = 0;
+  };
+
+  class OrderRange
+  {
+   public:
+    OrderIterator begin() const { return m_begin; }
+    OrderIterator end() const   { return m_end; }
+    std::size_t size() const    { return m_size; }
+    bool empty() const          { return m_size == 0; }
+
+   private:
+    friend class BasicOrderCache;
+    OrderRange(OrderIterator begin, OrderIterator end, std::size_t size)
+        : m_begin(begin), m_end(end), m_size(size) { }
+
+    OrderIterator m_begin;
+    OrderIterator m_end;
+    std::size_t m_size;
+  };
+
+  // iterates the cache state, so a loaded book is copied into the cache
+  // first, like any change does
+  OrderRange orders();
+
+  // point-in-time copy of the orders, sharing the books of the securities
+  // unchanged since the previous snapshot
+  OrderSnapshot snapshot();
+
  private:
-   MapOrders m_buyOrders;
-   MapOrders m_sellOrders;
-   OrderIds m_orderIds;
+   // shards its orders over OrderCache instances and keeps its own id index
+   friend class ConcurrentOrderCache;
+   // builds orders from its books like getAllOrders() does
+   friend class OrderSnapshot;
+   // replays changes through the string_view paths below
+   friend class OrderJournal;
+
+   std::unique_ptr<std::pmr::monotonic_buffer_resource> m_arena;
+   Resource* m_resource;
+   State* m_state;
+   std::unique_ptr<MappedBook> m_book;         // set until the first change after loadBook()
+   std::unique_ptr<WorkStealingPool> m_pool;  // created by the first parallel query
+   OrderJournal* m_journal = nullptr;
+   StatsPolicy m_stats;
+
+   State* createState();
+   void destroyState();
+
+   // clear() without journaling, also used by loadBook()
+   void reset();
+
+   // the pool of the given size, replacing one of another size
+   WorkStealingPool& pool(unsigned int threads);
+
+   // the first error of the order, checked in the same order for every way
+   // of adding one
+   static OrderError validate(const Order& order);
+   static OrderError validateFields(std::string_view orderId, std::string_view securityId, std::string_view side
+      , unsigned int qty, std::string_view user, std::string_view company);
+
+   // addOrder() and cancelOrder() on views of the fields, reporting instead
+   // of throwing and without building an Order
+   OrderError addOrderFields(std::string_view orderId, std::string_view securityId, Side side, unsigned int qty
+      , std::string_view user, std::string_view company);
+   void cancelOrderId(std::string_view orderId);
+
+   [[noreturn]] static void throwError(OrderError error);
+
+   static Side parseSide(const std::string& side);
+
+   static Order makeOrder(const OrderView& view);
+
+   OrderRef allocateRef();
+
+   // takes a ref and indexes the order id under it, NO_REF for a duplicate
+   // id or one the order id policy cannot store
+   OrderRef insertOrderId(std::string_view orderId);
+
+   // the ref indexed under the order id or nullptr
+   const OrderRef* findOrderId(std::string_view orderId) const;
+
+   SymbolId internSecurity(std::string_view securityId);
+   SymbolId internUser(std::string_view user);
+
+   // builds the cache state from the loaded book and drops the mapping
+   void materialize();
+
+   // interns the securities and companies of the loaded book and sums the
+   // company totals the exposure queries read until materialize(); the
+   // names returned by queries outlive the mapping like those of the cache
+   void indexBook();
+
+   // the company totals of the security, nullptr if it is unknown
+   const CompanyQtyMap* companyTotals(const std::string& securityId) const;
 
-   void erase(std::vector<OrderExpander>& vct, std::size_t& index);
+   // puts the order with an indexed id into its book, the user index and the
+   // totals
+   void insertOrder(OrderRef ref, SymbolId securityId, Side side, const Order& order);
+   void insertOrder(OrderRef ref, SymbolId securityId, Side side, unsigned int qty, SymbolId user, SymbolId company);
 
-   bool cancelOrder(const std::string& orderId
-      , MapOrders& mapOrders);
+   // removes the order from the book, its qty bucket, the order
+   // index and the user index, the last order of the book is swap-moved into
+   // the freed slot and its location is updated
+   void erase(OrderRef ref);
 
-   void cancelOrdersForUser(const std::string& user
-      , MapOrders& mapOrders
-      , OrderIds& orderIds);
+   // drops the id of the order from the index and frees its ref
+   void releaseOrderId(OrderRef ref);
 
-   void cancelOrdersForSecIdWithMinimumQty(const std::string& securityId
-      , unsigned int minQty
-      , MapOrders& mapOrders
-      , OrderIds& orderIds);
+   // records an add whose id is indexed but not yet placed, releasing the
+   // id if the journal rejects it
+   void journalAdd(OrderRef ref, std::string_view orderId, std::string_view securityId, Side side, unsigned int qty
+      , std::string_view user, std::string_view company);
+
+   // removes the orders with qty >= minQty, which are the buckets from
+   // first on, in one pass over the columns of the side
+   void eraseTail(SecurityBook& book, Side side, std::size_t first, unsigned int minQty);
+
+   void eraseUserOrder(SymbolId user, std::size_t userIndex);
+   void eraseQtyOrder(SecurityOrders& orders, std::size_t bucket, std::size_t qtyIndex);
+
+   bool contains(std::string_view orderId) const;
+
+   // resting orders, in the loaded book or in the cache state
+   std::size_t orderCount() const;
+
+   // appends the ids of the orders cancelOrdersForUser() and
+   // cancelOrdersForSecIdWithMinimumQty() would remove
+   void collectUserOrderIds(std::string_view user, std::vector<std::string>& ids) const;
+   void collectMinimumQtyOrderIds(std::string_view securityId, unsigned int minQty
+      , std::vector<std::string>& ids) const;
+
+   // the cached matching size, false when it must be computed first
+   bool cachedMatchingSize(std::string_view securityId, unsigned int& size) const;
+
+   std::shared_ptr<const OrderSnapshot::Book> makeSnapshotBook(SymbolId securityId) const;
+
+   // computes the matching size from the totals unless it is cached
+   static unsigned int matchingSize(SecurityTotals& totals);
+   static unsigned int computeMatchingSize(const SecurityTotals& totals);
+   static unsigned long long maxMatchingQty(const SecurityTotals& totals);
+
+   // executeMatches() without the checks
+   unsigned long long executeSecurity(std::string_view securityId, FillSink& sink);
+
+   // replays a journaled fill: takes qty off both orders and removes those
+   // left with none, an order not in the cache is skipped
+   void applyFill(std::string_view buyOrderId, std::string_view sellOrderId, unsigned int qty);
+   void reduceOrder(std::string_view orderId, unsigned int qty);
+
+   // splits the qty to execute between the companies of the book, so that
+   // no company executes more than the others can take from it
+   void planExecution(const SecurityTotals& totals, unsigned long long executed);
+
+   // lays out the qty the companies execute on a side as portions of their
+   // orders, company by company in plan order for buys and reversed for sells
+   void queuePortions(const SecurityOrders& orders, Side side);
+
+   // pairs the buy and sell portions into fills
+   void pairPortions(unsigned long long executed);
+   void pairRange(unsigned long long buyOffset, unsigned long long sellOffset, unsigned long long qty);
+
+   // takes the executed qty off the orders of a side, collecting those filled in full
+   void applyPortions(SecurityBook& book, Side side);
+
+   // takes qty, less than its own, off the order at index of a side
+   void reduceQty(SecurityBook& book, Side side, std::size_t index, unsigned int qty);
+
+   void updateTotals(SecurityTotals& totals, Side side, SymbolId companyId, unsigned int qty, bool isAdd);
 };
+
+extern template class BasicOrderCache<StringOrderIds, CollectStats>;
+extern template class BasicOrderCache<StringOrderIds, NoStats>;
+extern template class BasicOrderCache<FixedOrderIds<16>, CollectStats>;
+extern template class BasicOrderCache<FixedOrderIds<16>, NoStats>;
+
+using OrderCache = BasicOrderCache<>;
+
+template<typename IdPolicy, typename StatsPolicy>
+template<typename Visitor>
+void BasicOrderCache<IdPolicy, StatsPolicy>::forEachOrder(Visitor&& visitor) const
+{
+  if(m_book)
+  {
+    const MappedBook& book = *m_book;
+    for(std::size_t securityId = 0; securityId < book.securityCount(); securityId++)
+    {
+      const book_file::BookSecurity& run = book.securityRun(securityId);
+      std::string_view securityName = book.security(securityId);
+      std::size_t sells = run.firstRecord + run.buyCount;
+      for(std::size_t i = run.firstRecord; i < sells + run.sellCount; i++)
+      {
+        const book_file::BookRecord& record = book.record(i);
+        visitor(OrderView{ book.orderId(i), securityName, sideName(i < sells ? Side::Buy : Side::Sell), record.qty
+          , book.user(record.user), book.company(record.company) });
+      }
+    }
+    return;
+  }
+
+  const State& state = *m_state;
+  for(SymbolId securityId = 0; securityId < state.books.size(); securityId++)
+  {
+    std::string_view securityName = state.securities.name(securityId);
+    for(Side side: { Side::Buy, Side::Sell })
+    {
+      const SecurityOrders& orders = state.books[securityId].sides[static_cast<unsigned int>(side)];
+      for(std::size_t i = 0; i < orders.size(); i++)
+      {
+        visitor(OrderView{ state.locations[orders.ref[i]].orderId, securityName, sideName(side), orders.qty[i]
+          , state.users.name(orders.user[i]), state.companies.name(orders.company[i]) });
+      }
+    }
+  }
+}
+
+template<typename Visitor>
+void OrderSnapshot::forEachOrder(Visitor&& visitor) const
+{
+  for(const auto& book: m_books)
+  {
+    const char* names = book->names.data();
+    for(const Book::Record& record: book->records)
+    {
+      visitor(OrderView{ std::string_view(names + record.orderId, record.orderIdSize), book->securityId
+        , sideName(record.side), record.qty, std::string_view(names + record.user, record.userSize)
+        , std::string_view(names + record.company, record.companySize) });
+    }
+  }
+}
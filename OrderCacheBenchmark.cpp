@@ -0,0 +1,1035 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ConcurrentOrderCache.h"
+#include "CountingAllocator.h"
+#include "FillSink.h"
+#include "FilterKernels.h"
+#include "FlatHashMap.h"
+#include "OrderCache.h"
+#include "OrderIdPolicy.h"
+#include "OrderIngestQueue.h"
+#include "OrderJournal.h"
+#include "benchmark/benchmark.h"
+
+// Same shape of book as the Performance tests in OrderCacheTest.cpp
+static constexpr unsigned int NUM_USERS = 1000;
+static constexpr unsigned int NUM_COMPANIES = 100;
+static constexpr unsigned int NUM_SECURITIES = 1000;
+static constexpr unsigned int ORDER_QTY_MULTIPLIER = 100;
+static constexpr unsigned int MIN_QTY = 2500;
+
+static std::string userName(unsigned int i) { return "User" + std::to_string(i); }
+static std::string securityName(unsigned int i) { return "SecId" + std::to_string(i); }
+
+// The first count orders of one fixed random sequence, generated on first use
+static const std::vector<Order>& orders(std::size_t count) {
+    static std::vector<Order> generated;
+    static std::mt19937 gen = [] {
+        std::seed_seq seed{1, 2, 3, 4, 5};
+        return std::mt19937(seed);
+    }();
+    std::uniform_int_distribution<unsigned int> usersDist(0, NUM_USERS - 1);
+    std::uniform_int_distribution<unsigned int> companiesDist(0, NUM_COMPANIES - 1);
+    std::uniform_int_distribution<unsigned int> secIdsDist(0, NUM_SECURITIES - 1);
+    std::uniform_int_distribution<unsigned int> sidesDist(0, 1);
+    std::uniform_int_distribution<unsigned int> qtyDist(1, 50);
+
+    generated.reserve(count);
+    while (generated.size() < count) {
+        std::string orderId = "OrdId" + std::to_string(generated.size());
+        std::string user = userName(usersDist(gen));
+        std::string company = "Comp" + std::to_string(companiesDist(gen));
+        std::string secId = securityName(secIdsDist(gen));
+        std::string side = sidesDist(gen) ? "Sell" : "Buy";
+        generated.push_back(Order{orderId, secId, side, qtyDist(gen) * ORDER_QTY_MULTIPLIER, user, company});
+    }
+    return generated;
+}
+
+static std::unique_ptr<OrderCache> filledCache(std::size_t count) {
+    auto cache = std::make_unique<OrderCache>();
+    const std::vector<Order>& list = orders(count);
+    for (std::size_t i = 0; i < count; i++) {
+        cache->addOrder(list[i]);
+    }
+    return cache;
+}
+
+// Reports totals over all iterations: ns/op from the timed part only, items/s
+// for the orders touched and bytes/op allocated while timed
+static void report(benchmark::State& state, std::size_t ops, std::size_t items, std::size_t bytes) {
+    state.SetItemsProcessed(static_cast<int64_t>(items));
+    state.counters["ns/op"] = benchmark::Counter(ops / 1e9, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["bytes/op"] = benchmark::Counter(ops ? static_cast<double>(bytes) / ops : 0);
+}
+
+// Adds count orders to an empty Cache
+template<typename Cache>
+static void addOrders(benchmark::State& state) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    const std::vector<Order>& list = orders(count);
+    std::unique_ptr<Cache> cache;
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        cache = std::make_unique<Cache>();
+        std::size_t before = heapAllocatedBytes;
+        state.ResumeTiming();
+        for (std::size_t i = 0; i < count; i++) {
+            cache->addOrder(list[i]);
+        }
+        bytes += heapAllocatedBytes - before;
+        ops += count;
+    }
+    report(state, ops, ops, bytes);
+}
+
+static void BM_AddOrder(benchmark::State& state) {
+    addOrders<OrderCache>(state);
+}
+
+// the same without stats, the cost of collecting them is the difference
+static void BM_AddOrder_NoStats(benchmark::State& state) {
+    addOrders<BasicOrderCache<StringOrderIds, NoStats>>(state);
+}
+
+// Adds count orders to an empty cache from views of name tables, the way a
+// feed handler passes fields out of its own buffers; the orders have the
+// shape of orders(count) but are drawn separately, since the Order accessors
+// return copies
+static void BM_EmplaceOrder(benchmark::State& state) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    struct Fields {
+        std::uint16_t securityId;
+        std::uint16_t user;
+        std::uint8_t company;
+        std::uint8_t side;
+        std::uint16_t qty;
+    };
+    std::vector<std::string> users, companies, securities;
+    for (unsigned int i = 0; i < NUM_USERS; i++) {
+        users.push_back(userName(i));
+    }
+    for (unsigned int i = 0; i < NUM_COMPANIES; i++) {
+        companies.push_back("Comp" + std::to_string(i));
+    }
+    for (unsigned int i = 0; i < NUM_SECURITIES; i++) {
+        securities.push_back(securityName(i));
+    }
+    std::mt19937 gen(7);
+    std::vector<Fields> fields(count);
+    for (auto& order : fields) {
+        order = Fields{ static_cast<std::uint16_t>(gen() % NUM_SECURITIES), static_cast<std::uint16_t>(gen() % NUM_USERS)
+            , static_cast<std::uint8_t>(gen() % NUM_COMPANIES), static_cast<std::uint8_t>(gen() % 2)
+            , static_cast<std::uint16_t>(gen() % 50 + 1) };
+    }
+
+    std::unique_ptr<OrderCache> cache;
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        cache = std::make_unique<OrderCache>();
+        std::size_t before = heapAllocatedBytes;
+        state.ResumeTiming();
+        char orderId[32] = "OrdId";
+        for (std::size_t i = 0; i < count; i++) {
+            const Fields& order = fields[i];
+            char* end = std::to_chars(orderId + 5, orderId + sizeof(orderId), i).ptr;
+            cache->emplaceOrder(std::string_view(orderId, end - orderId), securities[order.securityId]
+                , order.side ? "Sell" : "Buy", order.qty * ORDER_QTY_MULTIPLIER, users[order.user]
+                , companies[order.company]);
+        }
+        bytes += heapAllocatedBytes - before;
+        ops += count;
+    }
+    report(state, ops, ops, bytes);
+}
+
+// Cancels every order of a cache of count orders by id
+static void BM_CancelOrder(benchmark::State& state) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    std::vector<std::string> ids;
+    ids.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+        ids.push_back(orders(count)[i].orderId());
+    }
+    std::unique_ptr<OrderCache> cache;
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        cache = filledCache(count);
+        std::size_t before = heapAllocatedBytes;
+        state.ResumeTiming();
+        for (const auto& id : ids) {
+            cache->cancelOrder(id);
+        }
+        bytes += heapAllocatedBytes - before;
+        ops += count;
+    }
+    report(state, ops, ops, bytes);
+}
+
+// Cancels the orders of every user of a cache of count orders, one call per user
+static void BM_CancelOrdersForUser(benchmark::State& state) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    std::vector<std::string> users;
+    for (unsigned int i = 0; i < NUM_USERS; i++) {
+        users.push_back(userName(i));
+    }
+    std::unique_ptr<OrderCache> cache;
+    std::size_t ops = 0, items = 0, bytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        cache = filledCache(count);
+        std::size_t before = heapAllocatedBytes;
+        state.ResumeTiming();
+        for (const auto& user : users) {
+            cache->cancelOrdersForUser(user);
+        }
+        bytes += heapAllocatedBytes - before;
+        ops += users.size();
+        items += count;
+    }
+    report(state, ops, items, bytes);
+}
+
+// Cancels the orders of at least MIN_QTY in every security of a cache of
+// count orders, about half of them, one call per security
+static void BM_CancelOrdersForSecIdWithMinimumQty(benchmark::State& state) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    std::vector<std::string> secIds;
+    for (unsigned int i = 0; i < NUM_SECURITIES; i++) {
+        secIds.push_back(securityName(i));
+    }
+    std::size_t removed = 0;
+    for (std::size_t i = 0; i < count; i++) {
+        removed += orders(count)[i].qty() >= MIN_QTY;
+    }
+    std::unique_ptr<OrderCache> cache;
+    std::size_t ops = 0, items = 0, bytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        cache = filledCache(count);
+        std::size_t before = heapAllocatedBytes;
+        state.ResumeTiming();
+        for (const auto& secId : secIds) {
+            cache->cancelOrdersForSecIdWithMinimumQty(secId, MIN_QTY);
+        }
+        bytes += heapAllocatedBytes - before;
+        ops += secIds.size();
+        items += removed;
+    }
+    report(state, ops, items, bytes);
+}
+
+// Matching size of every security of a cache of count orders, each changed
+// since its last query so nothing is served from the cached result
+static void BM_GetMatchingSizeForSecurity(benchmark::State& state) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    std::unique_ptr<OrderCache> cache = filledCache(count);
+    std::vector<std::string> secIds, probeIds;
+    for (unsigned int i = 0; i < NUM_SECURITIES; i++) {
+        secIds.push_back(securityName(i));
+        probeIds.push_back("Probe" + secIds.back());
+    }
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (std::size_t i = 0; i < secIds.size(); i++) {
+            cache->addOrder(Order{probeIds[i], secIds[i], "Buy", 100, "ProbeUser", "ProbeCompany"});
+            cache->cancelOrder(probeIds[i]);
+        }
+        std::size_t before = heapAllocatedBytes;
+        state.ResumeTiming();
+        for (const auto& secId : secIds) {
+            benchmark::DoNotOptimize(cache->getMatchingSizeForSecurity(secId));
+        }
+        bytes += heapAllocatedBytes - before;
+        ops += secIds.size();
+    }
+    report(state, ops, ops, bytes);
+}
+
+// Matching sizes of all securities of a cache of count orders in one call on
+// a pool of threads; each security is changed before every call so nothing
+// is served from the cached results. With mapped set the cache serves a
+// loaded book of those orders, whose sizes are stored in the file
+static void benchmarkAllSecurities(benchmark::State& state, bool mapped) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    const unsigned int threads = static_cast<unsigned int>(state.range(1));
+    const std::string path = "OrderCacheBenchmark_all_securities.bin";
+    std::unique_ptr<OrderCache> cache = filledCache(count);
+    if (mapped) {
+        cache->saveBook(path);
+        cache->loadBook(path);
+    }
+    std::vector<std::string> secIds, probeIds;
+    for (unsigned int i = 0; i < NUM_SECURITIES; i++) {
+        secIds.push_back(securityName(i));
+        probeIds.push_back("Probe" + secIds.back());
+    }
+    // starts the pool outside the timed part
+    cache->getMatchingSizeForAllSecurities(threads);
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        if (!mapped) {
+            state.PauseTiming();
+            for (std::size_t i = 0; i < secIds.size(); i++) {
+                cache->addOrder(Order{probeIds[i], secIds[i], "Buy", 100, "ProbeUser", "ProbeCompany"});
+                cache->cancelOrder(probeIds[i]);
+            }
+            state.ResumeTiming();
+        }
+        std::size_t before = heapAllocatedBytes;
+        benchmark::DoNotOptimize(cache->getMatchingSizeForAllSecurities(threads));
+        bytes += heapAllocatedBytes - before;
+        ops++;
+    }
+    if (mapped) {
+        std::remove(path.c_str());
+    }
+    report(state, ops, ops * NUM_SECURITIES, bytes);
+}
+
+static void BM_GetMatchingSizeForAllSecurities(benchmark::State& state) {
+    benchmarkAllSecurities(state, false);
+}
+
+static void BM_GetMatchingSizeForAllSecurities_Mapped(benchmark::State& state) {
+    benchmarkAllSecurities(state, true);
+}
+
+// An OrderCache behind one global mutex and the sharded ConcurrentOrderCache,
+// written to from several threads
+struct LockedWriters {
+    void add(const Order& order) { std::lock_guard<std::mutex> lock(mutex); cache.addOrder(order); }
+    void cancel(const std::string& orderId) { std::lock_guard<std::mutex> lock(mutex); cache.cancelOrder(orderId); }
+
+    std::mutex mutex;
+    OrderCache cache;
+};
+
+struct ShardedWriters {
+    void add(const Order& order) { cache.addOrder(order); }
+    void cancel(const std::string& orderId) { cache.cancelOrder(orderId); }
+
+    ConcurrentOrderCache cache;
+};
+
+// Every thread adds its share of count orders and cancels them again, so the
+// cache is empty between iterations; items are the adds and cancels of all
+// threads. The first thread sets up the shared cache before the threads start
+template<typename Writers>
+static void benchmarkWriters(benchmark::State& state) {
+    static std::unique_ptr<Writers> writers;
+    static const std::vector<Order>* list;
+    static std::vector<std::string> orderIds;
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    if (state.thread_index() == 0) {
+        writers = std::make_unique<Writers>();
+        list = &orders(count);
+        orderIds.clear();
+        for (std::size_t i = 0; i < count; i++) {
+            orderIds.push_back((*list)[i].orderId());
+        }
+    }
+    const std::size_t first = static_cast<std::size_t>(state.thread_index());
+    const std::size_t step = static_cast<std::size_t>(state.threads());
+    std::size_t items = 0;
+    for (auto _ : state) {
+        for (std::size_t i = first; i < count; i += step) {
+            writers->add((*list)[i]);
+        }
+        for (std::size_t i = first; i < count; i += step) {
+            writers->cancel(orderIds[i]);
+        }
+        items += 2 * ((count - first + step - 1) / step);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(items));
+    if (state.thread_index() == 0) {
+        writers.reset();
+    }
+}
+
+static void BM_ConcurrentWriters_GlobalMutex(benchmark::State& state) {
+    benchmarkWriters<LockedWriters>(state);
+}
+
+static void BM_ConcurrentWriters_Sharded(benchmark::State& state) {
+    benchmarkWriters<ShardedWriters>(state);
+}
+
+// Every thread pushes its share of count orders into one OrderIngestQueue,
+// then cancels them again, keeping WINDOW commands in flight and timing each
+// from push to completion; reports the latency percentiles in us averaged
+// over the threads, and items for the commands of all threads
+static void BM_IngestQueue_Latency(benchmark::State& state) {
+    constexpr std::size_t WINDOW = 64;
+    static std::unique_ptr<OrderCache> cache;
+    static std::unique_ptr<OrderIngestQueue> queue;
+    static const std::vector<Order>* list;
+    static std::vector<std::string> orderIds;
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    if (state.thread_index() == 0) {
+        cache = std::make_unique<OrderCache>();
+        queue = std::make_unique<OrderIngestQueue>(*cache);
+        list = &orders(count);
+        orderIds.clear();
+        for (std::size_t i = 0; i < count; i++) {
+            orderIds.push_back((*list)[i].orderId());
+        }
+    }
+
+    std::vector<OrderIngestQueue::Completion> completions(WINDOW);
+    std::vector<std::chrono::steady_clock::time_point> pushed(WINDOW);
+    std::vector<double> latencies;
+    std::size_t sent = 0;
+    // waits for the command in the slot and records its latency
+    auto complete = [&](std::size_t slot) {
+        completions[slot].wait();
+        latencies.push_back(std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - pushed[slot]).count());
+        completions[slot].done.store(false);
+    };
+    const std::size_t first = static_cast<std::size_t>(state.thread_index());
+    const std::size_t step = static_cast<std::size_t>(state.threads());
+    for (auto _ : state) {
+        for (int cancel = 0; cancel < 2; cancel++) {
+            for (std::size_t i = first; i < count; i += step, sent++) {
+                std::size_t slot = sent % WINDOW;
+                if (sent >= WINDOW) {
+                    complete(slot);
+                }
+                pushed[slot] = std::chrono::steady_clock::now();
+                if (cancel) {
+                    queue->cancelOrder(orderIds[i], &completions[slot]);
+                } else {
+                    queue->addOrder((*list)[i], &completions[slot]);
+                }
+            }
+        }
+        // the cancels of this iteration are applied before the next adds
+        for (std::size_t n = std::min(sent, WINDOW); n > 0; n--) {
+            complete((sent - n) % WINDOW);
+        }
+        sent = 0;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        double value = latencies.empty() ? 0 : latencies[static_cast<std::size_t>(p * (latencies.size() - 1))];
+        return benchmark::Counter(value, benchmark::Counter::kAvgThreads);
+    };
+    state.counters["p50_us"] = percentile(0.5);
+    state.counters["p99_us"] = percentile(0.99);
+    state.counters["p99.9_us"] = percentile(0.999);
+    state.counters["max_us"] = percentile(1.0);
+    state.SetItemsProcessed(static_cast<int64_t>(latencies.size()));
+    if (state.thread_index() == 0) {
+        queue.reset();
+        cache.reset();
+    }
+}
+
+// Snapshots a cache of count orders after an order was added to and
+// cancelled from each of the first changed securities, so only their books
+// are copied; reports the memory of a snapshot and what the one before it
+// no longer shares with the cache, in KB
+static void benchmarkSnapshot(benchmark::State& state, unsigned int changed) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    std::unique_ptr<OrderCache> cache = filledCache(count);
+    std::vector<std::string> secIds, probeIds;
+    for (unsigned int i = 0; i < changed; i++) {
+        secIds.push_back(securityName(i));
+        probeIds.push_back("Probe" + secIds.back());
+    }
+    OrderSnapshot previous = cache->snapshot();
+    std::size_t ops = 0, bytes = 0, exclusiveBytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (std::size_t i = 0; i < secIds.size(); i++) {
+            cache->addOrder(Order{probeIds[i], secIds[i], "Buy", 100, "ProbeUser", "ProbeCompany"});
+            cache->cancelOrder(probeIds[i]);
+        }
+        std::size_t before = heapAllocatedBytes;
+        state.ResumeTiming();
+        OrderSnapshot next = cache->snapshot();
+        bytes += heapAllocatedBytes - before;
+        ops++;
+        state.PauseTiming();
+        exclusiveBytes = previous.exclusiveBytes();
+        previous = std::move(next);
+        state.ResumeTiming();
+    }
+    report(state, ops, ops * count, bytes);
+    state.counters["snapshot_KB"] = benchmark::Counter(previous.memoryBytes() / 1024.0);
+    state.counters["previous_exclusive_KB"] = benchmark::Counter(exclusiveBytes / 1024.0);
+}
+
+// every security changed, so the whole book is copied
+static void BM_Snapshot_Full(benchmark::State& state) {
+    benchmarkSnapshot(state, NUM_SECURITIES);
+}
+
+// 1% of the securities changed
+static void BM_Snapshot_Incremental(benchmark::State& state) {
+    benchmarkSnapshot(state, NUM_SECURITIES / 100);
+}
+
+// Executes the matches of every security of a cache of count orders into a
+// reserved fill buffer; items are the fills
+static void BM_ExecuteMatches(benchmark::State& state) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    std::vector<std::string> secIds;
+    for (unsigned int i = 0; i < NUM_SECURITIES; i++) {
+        secIds.push_back(securityName(i));
+    }
+    FillBuffer fills;
+    fills.reserve(2 * count, 2 * count * 2 * 16);
+    std::size_t ops = 0, items = 0, bytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::unique_ptr<OrderCache> cache = filledCache(count);
+        fills.clear();
+        std::size_t before = heapAllocatedBytes;
+        state.ResumeTiming();
+        for (const auto& secId : secIds) {
+            benchmark::DoNotOptimize(cache->executeMatches(secId, fills));
+        }
+        bytes += heapAllocatedBytes - before;
+        ops += secIds.size();
+        items += fills.size();
+        state.PauseTiming();
+        cache.reset();
+        state.ResumeTiming();
+    }
+    report(state, ops, items, bytes);
+}
+
+// Exposure of every company in every security of a cache of count orders,
+// answered from the totals the cache keeps; with mapped set the cache serves
+// a loaded book of those orders, whose totals loadBook() sums. Items are the
+// exposures
+static void benchmarkExposure(benchmark::State& state, bool mapped) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    const std::string path = "OrderCacheBenchmark_exposure.bin";
+    std::unique_ptr<OrderCache> cache = filledCache(count);
+    if (mapped) {
+        cache->saveBook(path);
+        cache->loadBook(path);
+    }
+    std::vector<std::string> secIds, companies;
+    for (unsigned int i = 0; i < NUM_SECURITIES; i++) {
+        secIds.push_back(securityName(i));
+    }
+    for (unsigned int i = 0; i < NUM_COMPANIES; i++) {
+        companies.push_back("Comp" + std::to_string(i));
+    }
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        std::size_t before = heapAllocatedBytes;
+        unsigned long long total = 0;
+        for (const auto& secId : secIds) {
+            for (const auto& company : companies) {
+                CompanyExposure exposure = cache->getCompanyExposure(secId, company);
+                total += exposure.buyQty + exposure.sellQty;
+            }
+        }
+        benchmark::DoNotOptimize(total);
+        bytes += heapAllocatedBytes - before;
+        ops += secIds.size() * companies.size();
+    }
+    if (mapped) {
+        std::remove(path.c_str());
+    }
+    report(state, ops, ops, bytes);
+}
+
+static void BM_CompanyExposure(benchmark::State& state) {
+    benchmarkExposure(state, false);
+}
+
+static void BM_CompanyExposure_Mapped(benchmark::State& state) {
+    benchmarkExposure(state, true);
+}
+
+// The same exposures summed by the caller from getAllOrders(), the way they
+// were found before the cache kept company totals
+static void BM_CompanyExposure_AggregateAllOrders(benchmark::State& state) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    std::unique_ptr<OrderCache> cache = filledCache(count);
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        std::size_t before = heapAllocatedBytes;
+        std::unordered_map<std::string, unsigned long long> aggregated;
+        for (const auto& order : cache->getAllOrders()) {
+            aggregated[order.securityId() + "/" + order.company()] += order.qty();
+        }
+        benchmark::DoNotOptimize(aggregated.size());
+        bytes += heapAllocatedBytes - before;
+        ops += NUM_SECURITIES * NUM_COMPANIES;
+    }
+    report(state, ops, ops, bytes);
+}
+
+// Copies out all orders of a cache of count orders
+static void BM_GetAllOrders(benchmark::State& state) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    std::unique_ptr<OrderCache> cache = filledCache(count);
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        std::size_t before = heapAllocatedBytes;
+        std::vector<Order> all = cache->getAllOrders();
+        bytes += heapAllocatedBytes - before;
+        benchmark::DoNotOptimize(all.data());
+        state.PauseTiming();
+        all = std::vector<Order>();
+        state.ResumeTiming();
+        ops++;
+    }
+    report(state, ops, ops * count, bytes);
+}
+
+// Clears a cache of count orders, which allocates from the default resource
+// or, in arena mode, from its own arena
+static void benchmarkClear(benchmark::State& state, bool arena) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    const std::vector<Order>& list = orders(count);
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto cache = arena ? std::make_unique<OrderCache>(OrderCache::Arena{}) : std::make_unique<OrderCache>();
+        for (std::size_t i = 0; i < count; i++) {
+            cache->addOrder(list[i]);
+        }
+        std::size_t before = heapAllocatedBytes;
+        state.ResumeTiming();
+        cache->clear();
+        bytes += heapAllocatedBytes - before;
+        ops++;
+        state.PauseTiming();
+        cache.reset();
+        state.ResumeTiming();
+    }
+    report(state, ops, ops * count, bytes);
+}
+
+static void BM_Clear(benchmark::State& state) {
+    benchmarkClear(state, false);
+}
+
+static void BM_Clear_Arena(benchmark::State& state) {
+    benchmarkClear(state, true);
+}
+
+// Restores a saved book of count orders and queries the matching size of
+// every security, served from the mapped file; with change set it also
+// cancels one order, which copies the book into the cache
+static void benchmarkLoadBook(benchmark::State& state, bool change) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    const std::string path = "OrderCacheBenchmark_book.bin";
+    filledCache(count)->saveBook(path);
+    std::vector<std::string> secIds;
+    for (unsigned int i = 0; i < NUM_SECURITIES; i++) {
+        secIds.push_back(securityName(i));
+    }
+    const std::string cancelledId = orders(count)[0].orderId();
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        std::size_t before = heapAllocatedBytes;
+        OrderCache cache;
+        cache.loadBook(path);
+        for (const auto& secId : secIds) {
+            benchmark::DoNotOptimize(cache.getMatchingSizeForSecurity(secId));
+        }
+        if (change) {
+            cache.cancelOrder(cancelledId);
+        }
+        bytes += heapAllocatedBytes - before;
+        ops++;
+        state.PauseTiming();
+        cache.clear();
+        state.ResumeTiming();
+    }
+    std::remove(path.c_str());
+    report(state, ops, ops * count, bytes);
+}
+
+static void BM_LoadBook(benchmark::State& state) {
+    benchmarkLoadBook(state, false);
+}
+
+static void BM_LoadBook_FirstChange(benchmark::State& state) {
+    benchmarkLoadBook(state, true);
+}
+
+// Adds count orders to an empty cache and cancels every other one, with the
+// changes journaled to path unless it is empty; the journal is flushed
+// before the clock stops. Returns the number of changes
+static std::size_t journalChanges(OrderCache& cache, const std::string& path, bool sync, std::size_t count) {
+    const std::vector<Order>& list = orders(count);
+    std::unique_ptr<OrderJournal> journal;
+    if (!path.empty()) {
+        std::remove(path.c_str());
+        journal = std::make_unique<OrderJournal>(path, sync);
+        cache.setJournal(journal.get());
+    }
+    for (std::size_t i = 0; i < count; i++) {
+        cache.addOrder(list[i]);
+    }
+    for (std::size_t i = 0; i < count; i += 2) {
+        cache.cancelOrder(list[i].orderId());
+    }
+    if (journal) {
+        journal->flush();
+        cache.setJournal(nullptr);
+    }
+    return count + (count + 1) / 2;
+}
+
+// Changes of journalChanges() with journaling off, without sync and with
+// group commit; items are the changes
+static void benchmarkJournal(benchmark::State& state, const std::string& path, bool sync) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    orders(count);
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto cache = std::make_unique<OrderCache>();
+        std::size_t before = heapAllocatedBytes;
+        state.ResumeTiming();
+        ops += journalChanges(*cache, path, sync, count);
+        bytes += heapAllocatedBytes - before;
+        state.PauseTiming();
+        cache.reset();
+        state.ResumeTiming();
+    }
+    if (!path.empty()) {
+        std::remove(path.c_str());
+    }
+    report(state, ops, ops, bytes);
+}
+
+static void BM_Journal_Off(benchmark::State& state) {
+    benchmarkJournal(state, "", false);
+}
+
+static void BM_Journal_NoSync(benchmark::State& state) {
+    benchmarkJournal(state, "OrderCacheBenchmark_journal.bin", false);
+}
+
+static void BM_Journal_GroupCommit(benchmark::State& state) {
+    benchmarkJournal(state, "OrderCacheBenchmark_journal.bin", true);
+}
+
+// Replays the journal of journalChanges() into an empty cache; items are the changes
+static void BM_Journal_Replay(benchmark::State& state) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    const std::string path = "OrderCacheBenchmark_journal.bin";
+    {
+        OrderCache cache;
+        journalChanges(cache, path, false, count);
+    }
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto cache = std::make_unique<OrderCache>();
+        std::size_t before = heapAllocatedBytes;
+        state.ResumeTiming();
+        ops += OrderJournal::replay(path, *cache);
+        bytes += heapAllocatedBytes - before;
+        state.PauseTiming();
+        cache.reset();
+        state.ResumeTiming();
+    }
+    std::remove(path.c_str());
+    report(state, ops, ops, bytes);
+}
+
+// Writes the first count orders to a text order file at path
+static void writeOrderFile(const std::string& path, std::size_t count) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    const std::vector<Order>& list = orders(count);
+    for (std::size_t i = 0; i < count; i++) {
+        const Order& order = list[i];
+        file << order.orderId() << ' ' << order.securityId() << ' ' << order.side() << ' ' << order.qty()
+            << ' ' << order.user() << ' ' << order.company() << '\n';
+    }
+}
+
+// Loads a text order file of count orders into an empty cache with load;
+// reports bytes/s of the file besides the usual counters
+template<typename Load>
+static void benchmarkOrderFile(benchmark::State& state, Load load) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    const std::string path = "OrderCacheBenchmark_orders.txt";
+    writeOrderFile(path, count);
+    const std::size_t fileSize = static_cast<std::size_t>(std::filesystem::file_size(path));
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto cache = std::make_unique<OrderCache>();
+        std::size_t before = heapAllocatedBytes;
+        state.ResumeTiming();
+        load(*cache, path);
+        bytes += heapAllocatedBytes - before;
+        ops += count;
+        state.PauseTiming();
+        cache.reset();
+        state.ResumeTiming();
+    }
+    std::remove(path.c_str());
+    state.SetBytesProcessed(static_cast<int64_t>(ops / count * fileSize));
+    report(state, ops, ops, bytes);
+}
+
+static void BM_LoadOrderFile(benchmark::State& state) {
+    benchmarkOrderFile(state, [](OrderCache& cache, const std::string& path) {
+        benchmark::DoNotOptimize(cache.loadOrderFile(path));
+    });
+}
+
+// the usual way to read the file: getline, a string stream and addOrder
+static void BM_LoadOrderFile_Getline(benchmark::State& state) {
+    benchmarkOrderFile(state, [](OrderCache& cache, const std::string& path) {
+        std::ifstream file(path);
+        std::string line, orderId, securityId, side, user, company;
+        unsigned int qty;
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            fields >> orderId >> securityId >> side >> qty >> user >> company;
+            cache.addOrder(Order{orderId, securityId, side, qty, user, company});
+        }
+    });
+}
+
+// Columns of count orders as a security book keeps them, filtered below by
+// the minimum qty; about half of the qty values are below MIN_QTY
+struct FilterColumns {
+    std::vector<unsigned int> qty;
+    std::vector<unsigned int> company;
+    std::vector<unsigned int> user;
+    std::vector<std::string> orderId;
+};
+
+static FilterColumns filterColumns(std::size_t count) {
+    FilterColumns columns;
+    const std::vector<Order>& list = orders(count);
+    for (std::size_t i = 0; i < count; i++) {
+        columns.qty.push_back(list[i].qty());
+        columns.company.push_back(static_cast<unsigned int>(i % NUM_COMPANIES));
+        columns.user.push_back(static_cast<unsigned int>(i % NUM_USERS));
+        columns.orderId.push_back(list[i].orderId());
+    }
+    return columns;
+}
+
+// Removes the orders of at least MIN_QTY from the columns of count orders
+// one at a time, swap-moving the last order into each removed slot
+static void BM_Filter_SwapErase(benchmark::State& state) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    const FilterColumns source = filterColumns(count);
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        FilterColumns columns = source;
+        std::size_t before = heapAllocatedBytes;
+        state.ResumeTiming();
+        for (std::size_t i = 0; i < columns.qty.size(); i++) {
+            if (columns.qty[i] < MIN_QTY) {
+                continue;
+            }
+            std::swap(columns.qty[i], columns.qty.back());
+            std::swap(columns.company[i], columns.company.back());
+            std::swap(columns.user[i], columns.user.back());
+            std::swap(columns.orderId[i], columns.orderId.back());
+            columns.qty.pop_back();
+            columns.company.pop_back();
+            columns.user.pop_back();
+            columns.orderId.pop_back();
+            i--;
+        }
+        benchmark::DoNotOptimize(columns.qty.data());
+        bytes += heapAllocatedBytes - before;
+        ops++;
+    }
+    report(state, ops, ops * count, bytes);
+}
+
+// Removes the same orders with a select kernel followed by an in place
+// compaction of every column
+static void benchmarkSelectCompact(benchmark::State& state
+    , std::size_t (*select)(const unsigned int*, std::size_t, unsigned int, std::uint32_t*)) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    const FilterColumns source = filterColumns(count);
+    std::vector<std::uint32_t> sel(count);
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        FilterColumns columns = source;
+        std::size_t before = heapAllocatedBytes;
+        state.ResumeTiming();
+        std::size_t kept = select(columns.qty.data(), columns.qty.size(), MIN_QTY, sel.data());
+        compactColumn(columns.qty, sel.data(), kept);
+        compactColumn(columns.company, sel.data(), kept);
+        compactColumn(columns.user, sel.data(), kept);
+        compactColumn(columns.orderId, sel.data(), kept);
+        benchmark::DoNotOptimize(columns.qty.data());
+        bytes += heapAllocatedBytes - before;
+        ops++;
+    }
+    report(state, ops, ops * count, bytes);
+}
+
+static void BM_Filter_SelectCompact_Scalar(benchmark::State& state) {
+    benchmarkSelectCompact(state, selectLessScalar);
+}
+
+// the kernel selectLess() dispatches to, AVX2 when the CPU supports it
+static void BM_Filter_SelectCompact(benchmark::State& state) {
+    state.SetLabel(hasAvx2() ? "AVX2" : "scalar");
+    benchmarkSelectCompact(state, selectLess);
+}
+
+// Order ids "OrdId0" to "OrdId<count - 1>", shuffled
+static std::vector<std::string> shuffledIds(std::size_t count) {
+    std::vector<std::string> ids;
+    ids.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+        ids.push_back("OrdId" + std::to_string(i));
+    }
+    std::shuffle(ids.begin(), ids.end(), std::mt19937(7));
+    return ids;
+}
+
+// the id as the key type of a map
+static void makeKey(const std::string& id, std::string& key) { key = id; }
+
+template<std::size_t N>
+static void makeKey(const std::string& id, FixedString<N>& key) { key.assign(id); }
+
+// Inserts count order ids into an empty map, finds each of them, looks up as
+// many ids that are not in it and erases them all again; the maps key on
+// views of the ids the way the cache's order index does with StringOrderIds,
+// or on FixedString copies of them as with FixedOrderIds
+template<typename Map, typename Key, typename Insert, typename Find, typename Erase>
+static void benchmarkIdIndex(benchmark::State& state, Insert insert, Find find, Erase erase) {
+    const std::size_t count = static_cast<std::size_t>(state.range(0));
+    std::vector<std::string> names = shuffledIds(count);
+    std::vector<Key> ids(count), missing(count);
+    for (std::size_t i = 0; i < count; i++) {
+        makeKey(names[i], ids[i]);
+        makeKey("Missing" + std::to_string(i), missing[i]);
+    }
+    std::size_t ops = 0, bytes = 0;
+    for (auto _ : state) {
+        std::size_t before = heapAllocatedBytes;
+        Map map;
+        for (const auto& id : ids) {
+            insert(map, id);
+        }
+        std::size_t found = 0;
+        for (const auto& id : ids) {
+            found += find(map, id);
+        }
+        for (const auto& id : missing) {
+            found += find(map, id);
+        }
+        for (const auto& id : ids) {
+            erase(map, id);
+        }
+        bytes += heapAllocatedBytes - before;
+        benchmark::DoNotOptimize(found);
+        state.PauseTiming();
+        {
+            Map discarded(std::move(map));
+        }
+        state.ResumeTiming();
+        ops += 4 * count;
+    }
+    report(state, ops, ops, bytes);
+}
+
+static void BM_IdIndex_UnorderedMap(benchmark::State& state) {
+    benchmarkIdIndex<std::pmr::unordered_map<std::string_view, unsigned int>, std::string>(state
+        , [](auto& map, const std::string& id) { map.try_emplace(id, 1u); }
+        , [](auto& map, const std::string& id) { return map.find(id) != map.end(); }
+        , [](auto& map, const std::string& id) { map.erase(id); });
+}
+
+static void BM_IdIndex_FlatHashMap(benchmark::State& state) {
+    benchmarkIdIndex<FlatHashMap<std::string_view, unsigned int>, std::string>(state
+        , [](auto& map, const std::string& id) { map.tryEmplace(id, 1u); }
+        , [](auto& map, const std::string& id) { return map.contains(id); }
+        , [](auto& map, const std::string& id) { map.erase(id); });
+}
+
+static void BM_IdIndex_FixedString(benchmark::State& state) {
+    benchmarkIdIndex<FlatHashMap<FixedString<16>, unsigned int>, FixedString<16>>(state
+        , [](auto& map, const FixedString<16>& id) { map.tryEmplace(id, 1u); }
+        , [](auto& map, const FixedString<16>& id) { return map.contains(id); }
+        , [](auto& map, const FixedString<16>& id) { map.erase(id); });
+}
+
+// 1K to 10M orders
+#define ORDER_COUNTS RangeMultiplier(10)->Range(1000, 10000000)->Unit(benchmark::kMillisecond)
+
+BENCHMARK(BM_AddOrder)->ORDER_COUNTS;
+BENCHMARK(BM_AddOrder_NoStats)->ORDER_COUNTS;
+BENCHMARK(BM_EmplaceOrder)->ORDER_COUNTS;
+BENCHMARK(BM_CancelOrder)->ORDER_COUNTS;
+BENCHMARK(BM_CancelOrdersForUser)->ORDER_COUNTS;
+BENCHMARK(BM_CancelOrdersForSecIdWithMinimumQty)->ORDER_COUNTS;
+BENCHMARK(BM_GetMatchingSizeForSecurity)->ORDER_COUNTS;
+// 100K and 1M orders on 1 to 16 threads
+BENCHMARK(BM_GetMatchingSizeForAllSecurities)->ArgsProduct({{100000, 1000000}, {1, 2, 4, 8, 16}})
+    ->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_GetMatchingSizeForAllSecurities_Mapped)->ArgsProduct({{100000, 1000000}, {1, 2, 4, 8, 16}})
+    ->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_GetAllOrders)->ORDER_COUNTS;
+BENCHMARK(BM_CompanyExposure)->ORDER_COUNTS;
+BENCHMARK(BM_CompanyExposure_Mapped)->ORDER_COUNTS;
+BENCHMARK(BM_CompanyExposure_AggregateAllOrders)->ORDER_COUNTS;
+BENCHMARK(BM_Snapshot_Full)->ORDER_COUNTS;
+BENCHMARK(BM_Snapshot_Incremental)->ORDER_COUNTS;
+BENCHMARK(BM_ExecuteMatches)->ORDER_COUNTS;
+// 200K orders from 1 to 16 writer threads
+BENCHMARK(BM_ConcurrentWriters_GlobalMutex)->Arg(200000)->ThreadRange(1, 16)->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ConcurrentWriters_Sharded)->Arg(200000)->ThreadRange(1, 16)->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+// 200K orders from 1 to 8 producer threads
+BENCHMARK(BM_IngestQueue_Latency)->Arg(200000)->ThreadRange(1, 8)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Clear)->ORDER_COUNTS;
+BENCHMARK(BM_Clear_Arena)->ORDER_COUNTS;
+BENCHMARK(BM_LoadBook)->ORDER_COUNTS;
+BENCHMARK(BM_LoadBook_FirstChange)->ORDER_COUNTS;
+BENCHMARK(BM_Journal_Off)->ORDER_COUNTS;
+BENCHMARK(BM_Journal_NoSync)->ORDER_COUNTS;
+BENCHMARK(BM_Journal_GroupCommit)->ORDER_COUNTS;
+BENCHMARK(BM_Journal_Replay)->ORDER_COUNTS;
+BENCHMARK(BM_LoadOrderFile)->ORDER_COUNTS;
+BENCHMARK(BM_LoadOrderFile_Getline)->ORDER_COUNTS;
+// 1K to 1M orders
+BENCHMARK(BM_Filter_SwapErase)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Filter_SelectCompact_Scalar)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Filter_SelectCompact)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_IdIndex_UnorderedMap)->RangeMultiplier(4)->Range(1 << 20, 1 << 24)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IdIndex_FlatHashMap)->RangeMultiplier(4)->Range(1 << 20, 1 << 24)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IdIndex_FixedString)->RangeMultiplier(4)->Range(1 << 20, 1 << 24)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
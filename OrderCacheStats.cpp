@@ -0,0 +1,148 @@
+#include <algorithm>
+#include "OrderCacheStats.h"
+
+static constexpr std::size_t SUB_BUCKETS = std::size_t(1) << LatencyHistogram::SUB_BUCKET_BITS;
+
+// position of the highest set bit of a non-zero value
+static unsigned int highestBit(std::uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return 63 - static_cast<unsigned int>(__builtin_clzll(value));
+#else
+  unsigned int bit = 0;
+  while(value >>= 1)
+    bit++;
+  return bit;
+#endif
+}
+
+LatencyHistogram& LatencyHistogram::operator=(const LatencyHistogram& other)
+{
+  if(this == &other)
+    return *this;
+  for(auto& bucket: m_buckets)
+    bucket.store(0, std::memory_order_relaxed);
+  m_count.store(0, std::memory_order_relaxed);
+  m_total.store(0, std::memory_order_relaxed);
+  m_min.store(UINT64_MAX, std::memory_order_relaxed);
+  m_max.store(0, std::memory_order_relaxed);
+  return *this += other;
+}
+
+LatencyHistogram& LatencyHistogram::operator+=(const LatencyHistogram& other)
+{
+  for(std::size_t i = 0; i < BUCKET_COUNT; i++)
+    m_buckets[i].fetch_add(other.m_buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+  m_count.fetch_add(other.count(), std::memory_order_relaxed);
+  m_total.fetch_add(other.total(), std::memory_order_relaxed);
+  std::uint64_t otherMin = other.m_min.load(std::memory_order_relaxed);
+  if(otherMin < m_min.load(std::memory_order_relaxed))
+    m_min.store(otherMin, std::memory_order_relaxed);
+  if(other.max() > max())
+    m_max.store(other.max(), std::memory_order_relaxed);
+  return *this;
+}
+
+void LatencyHistogram::record(std::uint64_t nanoseconds)
+{
+  m_buckets[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_total.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+  // only a new extreme pays for the compare-exchange loop
+  std::uint64_t current = m_min.load(std::memory_order_relaxed);
+  while(nanoseconds < current && !m_min.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed))
+    ;
+  current = m_max.load(std::memory_order_relaxed);
+  while(nanoseconds > current && !m_max.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed))
+    ;
+}
+
+std::uint64_t LatencyHistogram::percentile(double fraction) const
+{
+  std::uint64_t values = count();
+  if(!values)
+    return 0;
+  if(fraction < 0)
+    fraction = 0;
+  std::uint64_t rank = static_cast<std::uint64_t>(fraction * values);
+  if(rank >= values)
+    rank = values - 1;
+
+  std::uint64_t seen = 0;
+  for(std::size_t i = 0; i < BUCKET_COUNT; i++)
+  {
+    seen += m_buckets[i].load(std::memory_order_relaxed);
+    if(seen > rank)
+      return std::min(bucketUpperBound(i), max());
+  }
+  return max();
+}
+
+std::size_t LatencyHistogram::bucketIndex(std::uint64_t value)
+{
+  // values below SUB_BUCKETS get a bucket each, above that the top
+  // SUB_BUCKET_BITS bits after the leading one pick the bucket
+  if(value < SUB_BUCKETS)
+    return static_cast<std::size_t>(value);
+  unsigned int exponent = highestBit(value);
+  if(exponent >= MAX_EXPONENT)
+    return BUCKET_COUNT - 1;
+  unsigned int shift = exponent - SUB_BUCKET_BITS;
+  return (std::size_t(shift) + 1) * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+std::uint64_t LatencyHistogram::bucketUpperBound(std::size_t index)
+{
+  if(index < SUB_BUCKETS)
+    return index;
+  if(index == BUCKET_COUNT - 1)
+    return UINT64_MAX;
+  unsigned int shift = static_cast<unsigned int>(index / SUB_BUCKETS - 1);
+  std::uint64_t lower = (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+  return lower + (std::uint64_t(1) << shift) - 1;
+}
+
+const char* statsMethodName(StatsMethod method)
+{
+  switch(method)
+  {
+    case StatsMethod::AddOrder:
+      return "addOrder";
+    case StatsMethod::AddOrders:
+      return "addOrders";
+    case StatsMethod::CancelOrder:
+      return "cancelOrder";
+    case StatsMethod::CancelOrdersForUser:
+      return "cancelOrdersForUser";
+    case StatsMethod::CancelOrdersForSecIdWithMinimumQty:
+      return "cancelOrdersForSecIdWithMinimumQty";
+    case StatsMethod::GetMatchingSizeForSecurity:
+      return "getMatchingSizeForSecurity";
+    case StatsMethod::GetMatchingSizeForAllSecurities:
+      return "getMatchingSizeForAllSecurities";
+    case StatsMethod::GetAllOrders:
+      return "getAllOrders";
+    case StatsMethod::ExecuteMatches:
+      return "executeMatches";
+    case StatsMethod::GetCompanyExposure:
+      return "getCompanyExposure";
+    case StatsMethod::GetCompanyExposures:
+      return "getCompanyExposures";
+    case StatsMethod::Count:
+      break;
+  }
+  return "";
+}
+
+void CollectStats::copyTo(OrderCacheStats& stats) const
+{
+  stats.latency = m_latency;
+  stats.ordersAdded = m_ordersAdded.load(std::memory_order_relaxed);
+  stats.ordersCancelled = m_ordersCancelled.load(std::memory_order_relaxed);
+  stats.ordersFilled = m_ordersFilled.load(std::memory_order_relaxed);
+  stats.executedQty = m_executedQty.load(std::memory_order_relaxed);
+  stats.maxDepth.resize(m_maxDepth.size());
+  for(std::size_t i = 0; i < m_maxDepth.size(); i++)
+    stats.maxDepth[i].maxDepth = m_maxDepth[i];
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Distribution of latencies in nanoseconds with HDR-style log-linear buckets:
+// every power of two is split into 2^SUB_BUCKET_BITS equal buckets, so a
+// value is known to within 1/16 of itself with a fixed, small table. Values
+// from 2^MAX_EXPONENT ns (about 68 s) on share the last bucket. Recording is
+// lock-free and may race with other records and with copies.
+class LatencyHistogram
+{
+ public:
+  static constexpr unsigned int SUB_BUCKET_BITS = 4;
+  static constexpr unsigned int MAX_EXPONENT = 36;
+  static constexpr std::size_t BUCKET_COUNT = std::size_t(MAX_EXPONENT - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+  LatencyHistogram() = default;
+  LatencyHistogram(const LatencyHistogram& other) { *this += other; }
+  LatencyHistogram& operator=(const LatencyHistogram& other);
+
+  // adds the values of other
+  LatencyHistogram& operator+=(const LatencyHistogram& other);
+
+  void record(std::uint64_t nanoseconds);
+
+  std::uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+  std::uint64_t total() const { return m_total.load(std::memory_order_relaxed); }
+  std::uint64_t min() const   { return count() ? m_min.load(std::memory_order_relaxed) : 0; }
+  std::uint64_t max() const   { return m_max.load(std::memory_order_relaxed); }
+  double mean() const         { return count() ? static_cast<double>(total()) / count() : 0; }
+
+  // upper bound of the bucket holding the value at fraction (0 to 1) of the
+  // sorted values, capped by max(); 0 when empty
+  std::uint64_t percentile(double fraction) const;
+
+  static std::size_t bucketIndex(std::uint64_t value);
+  static std::uint64_t bucketUpperBound(std::size_t index);
+
+ private:
+   std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> m_buckets{};
+   std::atomic<std::uint64_t> m_count{0};
+   std::atomic<std::uint64_t> m_total{0};
+   std::atomic<std::uint64_t> m_min{UINT64_MAX};
+   std::atomic<std::uint64_t> m_max{0};
+};
+
+// public OrderCache methods timed by the stats
+enum class StatsMethod : unsigned char
+{
+  AddOrder,
+  AddOrders,
+  CancelOrder,
+  CancelOrdersForUser,
+  CancelOrdersForSecIdWithMinimumQty,
+  GetMatchingSizeForSecurity,
+  GetMatchingSizeForAllSecurities,
+  GetAllOrders,
+  ExecuteMatches,
+  GetCompanyExposure,
+  GetCompanyExposures,
+  Count  // number of methods, not a method
+};
+
+static constexpr std::size_t STATS_METHOD_COUNT = static_cast<std::size_t>(StatsMethod::Count);
+
+const char* statsMethodName(StatsMethod method);
+
+// copy of the stats of a cache at one moment
+struct OrderCacheStats
+{
+  struct SecurityDepth
+  {
+    std::string securityId;
+    std::size_t maxDepth;  // most orders, buys and sells, resting at once
+  };
+
+  std::array<LatencyHistogram, STATS_METHOD_COUNT> latency;  // indexed by StatsMethod
+  std::uint64_t ordersAdded = 0;
+  std::uint64_t ordersCancelled = 0;
+  std::uint64_t ordersFilled = 0;      // removed by executeMatches()
+  std::uint64_t executedQty = 0;       // traded by executeMatches(), queries count nothing
+  std::vector<SecurityDepth> maxDepth;  // in the order the securities were first added
+
+  const LatencyHistogram& operator[](StatsMethod method) const { return latency[static_cast<std::size_t>(method)]; }
+};
+
+// Stats policy that records nothing; every hook is empty and inlines away,
+// so a cache built with it does not read the clock
+class NoStats
+{
+ public:
+  struct Timer { };
+
+  Timer time(StatsMethod) const { return {}; }
+  void ordersAdded(std::size_t) { }
+  void ordersCancelled(std::size_t) { }
+  void ordersFilled(std::size_t) { }
+  void executed(std::uint64_t) { }
+  void depth(std::uint32_t, std::size_t) { }
+  void clearDepths() { }
+
+  // leaves stats as constructed
+  void copyTo(OrderCacheStats&) const { }
+};
+
+// Stats policy that records the latency of every timed method call, the
+// counters and the deepest book seen per security. Timers and copyTo()
+// may be called from concurrent const calls on the cache; the other
+// hooks are only called by changes.
+class CollectStats
+{
+ public:
+  class Timer
+  {
+   public:
+    Timer(LatencyHistogram& histogram)
+        : m_histogram(histogram),
+          m_start(std::chrono::steady_clock::now()) { }
+
+    ~Timer()
+    {
+      auto elapsed = std::chrono::steady_clock::now() - m_start;
+      m_histogram.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+   private:
+     LatencyHistogram& m_histogram;
+     std::chrono::steady_clock::time_point m_start;
+  };
+
+  Timer time(StatsMethod method) const { return Timer(m_latency[static_cast<std::size_t>(method)]); }
+
+  void ordersAdded(std::size_t count)     { m_ordersAdded.fetch_add(count, std::memory_order_relaxed); }
+  void ordersCancelled(std::size_t count) { m_ordersCancelled.fetch_add(count, std::memory_order_relaxed); }
+  void ordersFilled(std::size_t count)    { m_ordersFilled.fetch_add(count, std::memory_order_relaxed); }
+  void executed(std::uint64_t qty)        { m_executedQty.fetch_add(qty, std::memory_order_relaxed); }
+
+  void depth(std::uint32_t securityId, std::size_t depth)
+  {
+    if(securityId >= m_maxDepth.size())
+      m_maxDepth.resize(securityId + 1, 0);
+    if(depth > m_maxDepth[securityId])
+      m_maxDepth[securityId] = depth;
+  }
+
+  // forgets the depths when the security ids are reassigned
+  void clearDepths() { m_maxDepth.clear(); }
+
+  // fills everything but the security names of stats.maxDepth
+  void copyTo(OrderCacheStats& stats) const;
+
+ private:
+   mutable std::array<LatencyHistogram, STATS_METHOD_COUNT> m_latency;
+   std::atomic<std::uint64_t> m_ordersAdded{0};
+   std::atomic<std::uint64_t> m_ordersCancelled{0};
+   std::atomic<std::uint64_t> m_ordersFilled{0};
+   std::atomic<std::uint64_t> m_executedQty{0};
+   std::vector<std::size_t> m_maxDepth;  // by security id
+};
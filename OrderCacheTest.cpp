@@ -1,9 +1,36 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <random>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <type_traits>
+#include "ConcurrentOrderCache.h"
+#include "CountingAllocator.h"
+#include "FillSink.h"
+#include "FilterKernels.h"
+#include "FlatHashMap.h"
+#include "MappedFile.h"
+#include "MpscRing.h"
 #include "OrderCache.h"
+#include "OrderFile.h"
+#include "OrderIdPolicy.h"
+#include "OrderIngestQueue.h"
+#include "OrderJournal.h"
+#include "WorkStealingPool.h"
 #include "gtest/gtest.h"
 
 using namespace std::chrono_literals;
@@ -27,6 +54,53 @@ class FailureListener : public ::testing::EmptyTestEventListener {
         return; \
     }
 
+// Memory resource counting the allocations it forwards to new/delete
+class CountingResource : public std::pmr::memory_resource {
+public:
+    std::size_t allocations = 0;
+    std::size_t outstandingBytes = 0;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        allocations++;
+        outstandingBytes += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+        outstandingBytes -= bytes;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// Memory resource that throws std::bad_alloc while failing is set, from any thread
+class FailingResource : public std::pmr::memory_resource {
+public:
+    std::atomic<bool> failing{false};
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        if (failing) {
+            throw std::bad_alloc();
+        }
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// Makes any allocation from the default memory resource fail while in scope
+struct NullDefaultResourceGuard {
+    std::pmr::memory_resource* previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+    ~NullDefaultResourceGuard() { std::pmr::set_default_resource(previous); }
+};
+
 class OrderCacheTest : public ::testing::Test {
 protected:
     OrderCache cache;
@@ -150,6 +224,80 @@ TEST_F(OrderCacheTest, BasicOperations_GetAllOrders_ReturnsCorrectNumberOfOrders
     ASSERT_EQ(allOrders.size(), 8);
 }
 
+// BasicOperations: Orders sharing securities, users and companies are returned with all their fields
+TEST_F(OrderCacheTest, BasicOperations_GetAllOrders_ReturnsOrderFields) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 100, "User1", "CompanyA"});
+    cache.addOrder(Order{"OrdId2", "SecId1", "Sell", 200, "User2", "CompanyA"});
+    cache.addOrder(Order{"OrdId3", "SecId2", "Sell", 300, "User1", "CompanyB"});
+
+    std::vector<Order> allOrders = cache.getAllOrders();
+    ASSERT_EQ(allOrders.size(), 3);
+    std::sort(allOrders.begin(), allOrders.end(), [](const Order& lhs, const Order& rhs) {
+        return lhs.orderId() < rhs.orderId();
+    });
+
+    ASSERT_EQ(allOrders[0].securityId(), "SecId1");
+    ASSERT_EQ(allOrders[0].side(), "Buy");
+    ASSERT_EQ(allOrders[0].qty(), 100);
+    ASSERT_EQ(allOrders[0].user(), "User1");
+    ASSERT_EQ(allOrders[0].company(), "CompanyA");
+    ASSERT_EQ(allOrders[1].side(), "Sell");
+    ASSERT_EQ(allOrders[1].user(), "User2");
+    ASSERT_EQ(allOrders[1].company(), "CompanyA");
+    ASSERT_EQ(allOrders[2].securityId(), "SecId2");
+    ASSERT_EQ(allOrders[2].user(), "User1");
+    ASSERT_EQ(allOrders[2].company(), "CompanyB");
+}
+
+// BasicOperations: forEachOrder and the order range visit the same orders as getAllOrders without allocating
+TEST_F(OrderCacheTest, BasicOperations_ForEachOrder_VisitsAllOrdersWithoutAllocating) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    CountingResource resource;
+    OrderCache countedCache(&resource);
+    countedCache.addOrder(Order{"OrdId1", "SecId1", "Buy", 100, "User1", "CompanyA"});
+    countedCache.addOrder(Order{"OrdId2", "SecId1", "Sell", 200, "User2", "CompanyA"});
+    countedCache.addOrder(Order{"OrdId3", "SecId2", "Sell", 300, "User1", "CompanyB"});
+    countedCache.addOrder(Order{"OrdId4", "SecId3", "Buy", 400, "User3", "CompanyC"});
+    countedCache.cancelOrder("OrdId4");
+
+    std::size_t allocations = resource.allocations;
+    std::size_t visited = 0;
+    unsigned int totalQty = 0;
+    {
+        NullDefaultResourceGuard guard;
+        countedCache.forEachOrder([&](const OrderView& order) {
+            visited++;
+            totalQty += order.qty;
+        });
+    }
+    ASSERT_EQ(resource.allocations, allocations);
+    ASSERT_EQ(visited, 3);
+    ASSERT_EQ(totalQty, 600);
+
+    std::vector<Order> allOrders = countedCache.getAllOrders();
+    OrderCache::OrderRange range = countedCache.orders();
+    ASSERT_EQ(range.size(), allOrders.size());
+    ASSERT_EQ(std::distance(range.begin(), range.end()), 3);
+    std::size_t i = 0;
+    for (const OrderView& order : range) {
+        ASSERT_EQ(order.orderId, allOrders[i].orderId());
+        ASSERT_EQ(order.securityId, allOrders[i].securityId());
+        ASSERT_EQ(order.side, allOrders[i].side());
+        ASSERT_EQ(order.qty, allOrders[i].qty());
+        ASSERT_EQ(order.user, allOrders[i].user());
+        ASSERT_EQ(order.company, allOrders[i].company());
+        i++;
+    }
+    ASSERT_EQ(i, 3);
+
+    OrderCache emptyCache;
+    ASSERT_TRUE(emptyCache.orders().empty());
+    ASSERT_TRUE(emptyCache.orders().begin() == emptyCache.orders().end());
+}
+
 // BasicOperations: Cancel a specific order
 TEST_F(OrderCacheTest, BasicOperations_CancelOrder_RemovesSpecificOrderById) {
     CHECK_GLOBAL_FAILURE_FLAG();
@@ -354,6 +502,90 @@ TEST_F(OrderCacheTest, MatchingSize_ManyToMany_MatchesBidirectionally) {
     ASSERT_EQ(matchingSize, 6500);
 }
 
+// MatchingSize: The maximum match is found whatever the order of insertion
+TEST_F(OrderCacheTest, MatchingSize_InsertionOrder_ReturnsMaximumMatch) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    // Pairing OrdId3 with OrdId1 first would leave OrdId4 only with its own company
+    cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 100, "User1", "CompanyB"});
+    cache.addOrder(Order{"OrdId2", "SecId1", "Buy", 100, "User2", "CompanyA"});
+    cache.addOrder(Order{"OrdId3", "SecId1", "Sell", 100, "User3", "CompanyC"});
+    cache.addOrder(Order{"OrdId4", "SecId1", "Sell", 100, "User4", "CompanyA"});
+
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 200);
+}
+
+// MatchingSize: Querying the matching size leaves the cache unchanged
+TEST_F(OrderCacheTest, MatchingSize_RepeatedQuery_DoesNotModifyCache) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+    cache.addOrder(Order{"OrdId2", "SecId1", "Sell", 400, "User2", "CompanyB"});
+    cache.addOrder(Order{"OrdId3", "SecId1", "Sell", 1000, "User3", "CompanyC"});
+
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 1000);
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 1000);
+    ASSERT_EQ(cache.getAllOrders().size(), 3);
+
+    cache.cancelOrder("OrdId3");
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 400);
+    cache.cancelOrdersForUser("User1");
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 0);
+}
+
+// MatchingSize: A cached matching size is refreshed only by changes to its own security
+TEST_F(OrderCacheTest, MatchingSize_CachedResult_TracksChangesPerSecurity) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+    cache.addOrder(Order{"OrdId2", "SecId1", "Sell", 300, "User2", "CompanyB"});
+    cache.addOrder(Order{"OrdId3", "SecId2", "Sell", 500, "User2", "CompanyB"});
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 300);
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId2"), 0);
+
+    cache.addOrder(Order{"OrdId4", "SecId2", "Buy", 200, "User1", "CompanyA"});
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 300);
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId2"), 200);
+
+    cache.addOrder(Order{"OrdId5", "SecId1", "Sell", 900, "User3", "CompanyC"});
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 1000);
+
+    cache.cancelOrdersForSecIdWithMinimumQty("SecId1", 900);
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 0);
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId2"), 200);
+}
+
+// MatchingSize: The parallel query for all securities agrees with the query per security
+TEST_F(OrderCacheTest, MatchingSize_AllSecurities_MatchesPerSecurityQuery) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    std::vector<Order> orders = generateOrders(20000);
+    for (const auto& order : orders) {
+        cache.addOrder(order);
+    }
+    // skew the book: one security gets many more companies and orders
+    for (int i = 0; i < 5000; i++) {
+        cache.addOrder(Order{"Skew" + std::to_string(i), secIds[0], sides[i % 2], 100
+            , users[i % NUM_USERS], "Skew" + std::to_string(i % 500)});
+    }
+
+    for (unsigned int threads : {1u, 2u, 4u, 0u}) {
+        std::vector<SecurityMatchingSize> sizes = cache.getMatchingSizeForAllSecurities(threads);
+        ASSERT_EQ(sizes.size(), NUM_SECURITIES);
+        OrderCache reference;
+        for (const auto& order : cache.getAllOrders()) {
+            reference.addOrder(order);
+        }
+        for (const auto& size : sizes) {
+            ASSERT_EQ(size.matchingSize, reference.getMatchingSizeForSecurity(std::string(size.securityId)));
+        }
+        cache.cancelOrdersForSecIdWithMinimumQty(secIds[threads], 2500);
+    }
+
+    OrderCache emptyCache;
+    ASSERT_TRUE(emptyCache.getMatchingSizeForAllSecurities().empty());
+}
+
 // MatchingSize: Matching size when only buy orders are present should be zero.
 TEST_F(OrderCacheTest, MatchingSize_OnlyBuyOrders_ReturnsZero) {
     CHECK_GLOBAL_FAILURE_FLAG();
@@ -475,6 +707,69 @@ TEST_F(OrderCacheTest, EdgeCases_AddOrder_ZeroQuantityThrowsException) {
     ASSERT_EQ(cache.getAllOrders().size(), 0);
 }
 
+// BasicOperations: Adding a batch applies the valid orders and reports the rejected ones
+TEST_F(OrderCacheTest, BasicOperations_AddOrders_ReportsRejectedOrdersByPosition) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+
+    std::vector<Order> batch{
+        Order{"OrdId2", "SecId2", "Sell", 3000, "User2", "CompanyB"},
+        Order{"OrdId1", "SecId1", "Sell", 500, "User3", "CompanyC"},
+        Order{"", "SecId1", "Sell", 500, "User3", "CompanyC"},
+        Order{"OrdId3", "SecId1", "Sell", 500, "User3", "CompanyC"},
+        Order{"OrdId4", "SecId2", "Hold", 600, "User4", "CompanyC"},
+        Order{"OrdId5", "SecId2", "Buy", 0, "User5", "CompanyB"},
+        Order{"OrdId3", "SecId2", "Buy", 100, "User5", "CompanyB"},
+        Order{"OrdId6", "SecId2", "Buy", 2000, "User7", "CompanyE"},
+        Order{"OrdId7", "", "Buy", 2000, "User7", "CompanyE"},
+    };
+    std::vector<BatchError> errors = cache.addOrders(std::move(batch));
+
+    ASSERT_EQ(errors.size(), 6);
+    ASSERT_EQ(errors[0].index, 1);
+    ASSERT_EQ(errors[0].error, OrderError::DuplicateOrderId);
+    ASSERT_EQ(errors[1].index, 2);
+    ASSERT_EQ(errors[1].error, OrderError::EmptyOrderId);
+    ASSERT_EQ(errors[2].index, 4);
+    ASSERT_EQ(errors[2].error, OrderError::InvalidSide);
+    ASSERT_EQ(errors[3].index, 5);
+    ASSERT_EQ(errors[3].error, OrderError::ZeroQty);
+    ASSERT_EQ(errors[4].index, 6);
+    ASSERT_EQ(errors[4].error, OrderError::DuplicateOrderId);
+    ASSERT_EQ(errors[5].index, 8);
+    ASSERT_EQ(errors[5].error, OrderError::EmptySecurityId);
+
+    ASSERT_EQ(cache.getAllOrders().size(), 4);
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 500);
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId2"), 2000);
+
+    // Orders added by a batch are cancelable like any other
+    cache.cancelOrdersForUser("User3");
+    cache.cancelOrder("OrdId6");
+    ASSERT_EQ(cache.getAllOrders().size(), 2);
+}
+
+// BasicOperations: A generated batch gives the same book as adding the orders one by one
+TEST_F(OrderCacheTest, BasicOperations_AddOrders_MatchesSingleAdds) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    std::vector<Order> orders = generateOrders(20000);
+    OrderCache batchCache;
+    ASSERT_TRUE(batchCache.addOrders(std::vector<Order>(orders)).empty());
+    for (const auto& order : orders) {
+        cache.addOrder(order);
+    }
+
+    ASSERT_EQ(batchCache.getAllOrders().size(), orders.size());
+    for (const auto& secId : secIds) {
+        ASSERT_EQ(batchCache.getMatchingSizeForSecurity(secId), cache.getMatchingSizeForSecurity(secId));
+    }
+    batchCache.cancelOrdersForSecIdWithMinimumQty(secIds[0], 2000);
+    cache.cancelOrdersForSecIdWithMinimumQty(secIds[0], 2000);
+    ASSERT_EQ(batchCache.getAllOrders().size(), cache.getAllOrders().size());
+}
+
 // EdgeCases: Test that attempting to replace an existing order causes an exception
 TEST_F(OrderCacheTest, EdgeCases_AddOrder_ReplaceExistingOrderThrowsException) {
     CHECK_GLOBAL_FAILURE_FLAG();
@@ -811,6 +1106,1842 @@ TEST_F(OrderCacheTest, EdgeCases_GetAllOrders_ResultNotModifiableExternally) {
     ASSERT_EQ(ordersAfter[0].orderId(), "OrdId1");
 }
 
+// EdgeCases: Canceling orders whose slot was reused by a swap-moved order
+TEST_F(OrderCacheTest, EdgeCases_CancelOrder_AfterSwapMoveRemovesCorrectOrder) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 100, "User1", "Company1"});
+    cache.addOrder(Order{"OrdId2", "SecId1", "Buy", 200, "User2", "Company2"});
+    cache.addOrder(Order{"OrdId3", "SecId1", "Buy", 300, "User3", "Company3"});
+
+    // OrdId3 is moved into the slot of OrdId1
+    cache.cancelOrder("OrdId1");
+    cache.cancelOrder("OrdId3");
+
+    std::vector<Order> orders = cache.getAllOrders();
+    ASSERT_EQ(orders.size(), 1);
+    ASSERT_EQ(orders[0].orderId(), "OrdId2");
+
+    // Canceled ids can be reused
+    EXPECT_NO_THROW(cache.addOrder(Order{"OrdId3", "SecId1", "Sell", 300, "User3", "Company3"}));
+    ASSERT_THROW(cache.addOrder(Order{"OrdId2", "SecId2", "Sell", 300, "User3", "Company3"}), std::runtime_error);
+}
+
+// EdgeCases: Canceling orders for a user after some of them were canceled individually or by quantity
+TEST_F(OrderCacheTest, EdgeCases_CancelOrdersForUser_AfterOtherCancelsRemovesRemaining) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 100, "User1", "Company1"});
+    cache.addOrder(Order{"OrdId2", "SecId2", "Sell", 900, "User1", "Company1"});
+    cache.addOrder(Order{"OrdId3", "SecId1", "Sell", 300, "User1", "Company1"});
+    cache.addOrder(Order{"OrdId4", "SecId3", "Buy", 400, "User1", "Company1"});
+    cache.addOrder(Order{"OrdId5", "SecId1", "Buy", 500, "User2", "Company2"});
+
+    cache.cancelOrder("OrdId1");
+    cache.cancelOrdersForSecIdWithMinimumQty("SecId2", 500);
+    cache.cancelOrdersForUser("User1");
+
+    std::vector<Order> orders = cache.getAllOrders();
+    ASSERT_EQ(orders.size(), 1);
+    ASSERT_EQ(orders[0].orderId(), "OrdId5");
+
+    // Orders added for the user afterwards are tracked again
+    cache.addOrder(Order{"OrdId6", "SecId1", "Sell", 600, "User1", "Company1"});
+    cache.cancelOrdersForUser("User1");
+    ASSERT_EQ(cache.getAllOrders().size(), 1);
+}
+
+// EdgeCases: Canceling by minimum quantity keeps equal quantities and the other indexes consistent
+TEST_F(OrderCacheTest, EdgeCases_CancelOrdersForSecIdWithMinimumQty_DuplicateQuantitiesAndLaterCancels) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 300, "User1", "Company1"});
+    cache.addOrder(Order{"OrdId2", "SecId1", "Buy", 500, "User2", "Company2"});
+    cache.addOrder(Order{"OrdId3", "SecId1", "Sell", 500, "User1", "Company1"});
+    cache.addOrder(Order{"OrdId4", "SecId1", "Buy", 499, "User3", "Company3"});
+    cache.addOrder(Order{"OrdId5", "SecId1", "Sell", 700, "User2", "Company2"});
+    cache.addOrder(Order{"OrdId6", "SecId1", "Buy", 500, "User3", "Company3"});
+
+    cache.cancelOrdersForSecIdWithMinimumQty("SecId1", 500);
+    ASSERT_EQ(cache.getAllOrders().size(), 2);
+
+    // The remaining orders are still reachable through the id and user indexes
+    cache.cancelOrder("OrdId4");
+    cache.cancelOrdersForUser("User1");
+    ASSERT_TRUE(cache.getAllOrders().empty());
+
+    // Canceled ids can be reused
+    EXPECT_NO_THROW(cache.addOrder(Order{"OrdId2", "SecId1", "Buy", 500, "User2", "Company2"}));
+    cache.cancelOrdersForSecIdWithMinimumQty("SecId1", 501);
+    ASSERT_EQ(cache.getAllOrders().size(), 1);
+}
+
+// EdgeCases: Canceling most orders of a security by minimum quantity compacts the book in one pass
+TEST_F(OrderCacheTest, EdgeCases_CancelOrdersForSecIdWithMinimumQty_BulkCancelKeepsIndexesConsistent) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    for (int i = 0; i < 100; i++) {
+        cache.addOrder(Order{"OrdId" + std::to_string(i), "SecId1", i % 2 ? "Buy" : "Sell",
+                             static_cast<unsigned int>(100 + i * 10), users[i % 3], companies[i % 5]});
+    }
+    cache.addOrder(Order{"OrdIdOther", "SecId2", "Buy", 5000, "User0", "Comp0"});
+
+    // Removes 80 of the 100 orders of SecId1
+    cache.cancelOrdersForSecIdWithMinimumQty("SecId1", 300);
+    std::vector<Order> orders = cache.getAllOrders();
+    ASSERT_EQ(orders.size(), 21);
+    for (const auto& order : orders) {
+        if (order.securityId() == "SecId1") {
+            ASSERT_LT(order.qty(), 300);
+        }
+    }
+
+    // Survivors moved by the compaction are still found by id and by user
+    cache.cancelOrder("OrdId19");
+    cache.cancelOrder("OrdId0");
+    ASSERT_EQ(cache.getAllOrders().size(), 19);
+    cache.cancelOrdersForUser("User1");
+    for (const auto& order : cache.getAllOrders()) {
+        ASSERT_NE(order.user(), "User1");
+    }
+    EXPECT_NO_THROW(cache.addOrder(Order{"OrdId50", "SecId1", "Sell", 900, "User1", "Comp1"}));
+}
+
+// EdgeCases: Canceling by minimum quantity after partial fills and cancels matches a filter over all orders
+TEST_F(OrderCacheTest, EdgeCases_CancelOrdersForSecIdWithMinimumQty_AfterPartialFillsMatchesFilter) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    std::uniform_int_distribution<unsigned int> qtyDist(1, 70000);
+    int next = 0;
+    FillBuffer fills;
+    for (unsigned int minQty : { 70000u, 40000u, 1025u, 1024u, 1023u, 300u, 64u, 2u, 1u }) {
+        for (int i = 0; i < 400; i++, next++) {
+            cache.addOrder(Order{"OrdId" + std::to_string(next), secIds[next % 2], next % 3 ? "Buy" : "Sell",
+                                 qtyDist(gen), users[next % 7], companies[next % 5]});
+        }
+        for (int i = next - 400; i < next; i += 9) {
+            cache.cancelOrder("OrdId" + std::to_string(i));
+        }
+        // partial fills move orders to smaller quantities
+        cache.executeMatches(secIds[0], fills);
+
+        std::vector<Order> before = cache.getAllOrders();
+        cache.cancelOrdersForSecIdWithMinimumQty(secIds[0], minQty);
+        std::vector<Order> after = cache.getAllOrders();
+        std::size_t kept = std::count_if(before.begin(), before.end(), [&](const Order& order) {
+            return order.securityId() != secIds[0] || order.qty() < minQty;
+        });
+        ASSERT_EQ(after.size(), kept);
+        for (const auto& order : after) {
+            ASSERT_TRUE(order.securityId() != secIds[0] || order.qty() < minQty);
+        }
+    }
+}
+
+// Allocation: Every internal allocation comes from the memory resource given to the cache
+TEST_F(OrderCacheTest, Allocation_MemoryResource_UsedForAllInternalContainers) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    // 16 char ids, past the small string buffer and at the limit of FixedOrderIds<16>
+    auto orderId = [](int i) {
+        char id[17];
+        std::snprintf(id, sizeof(id), "OrderIdentif%04d", i);
+        return std::string(id);
+    };
+    auto exercise = [&](auto* tag) {
+        using Cache = std::remove_pointer_t<decltype(tag)>;
+        CountingResource resource;
+        {
+            NullDefaultResourceGuard guard;
+            Cache pmrCache(&resource);
+            for (int i = 0; i < 200; i++) {
+                pmrCache.addOrder(Order{orderId(i), secIds[i % 7], i % 2 ? "Buy" : "Sell",
+                                        static_cast<unsigned int>(100 + i), users[i % 11], companies[i % 5]});
+            }
+            ASSERT_THROW(pmrCache.addOrder(Order{orderId(1), "SecId1", "Buy", 100, "User1", "Comp1"}), std::runtime_error);
+            pmrCache.cancelOrder(orderId(3));
+            pmrCache.cancelOrdersForUser(users[2]);
+            pmrCache.cancelOrdersForSecIdWithMinimumQty(secIds[0], 150);
+            pmrCache.getMatchingSizeForSecurity(secIds[1]);
+            ASSERT_FALSE(pmrCache.getAllOrders().empty());
+            pmrCache.clear();
+            ASSERT_TRUE(pmrCache.getAllOrders().empty());
+            pmrCache.addOrder(Order{"OrdId1", "SecId1", "Buy", 100, "User1", "Comp1"});
+        }
+        ASSERT_GT(resource.allocations, 0);
+        ASSERT_EQ(resource.outstandingBytes, 0);
+    };
+    exercise(static_cast<OrderCache*>(nullptr));
+    exercise(static_cast<BasicOrderCache<FixedOrderIds<16>>*>(nullptr));
+}
+
+// Allocation: The arena mode cache is reusable after clear()
+TEST_F(OrderCacheTest, Allocation_ArenaMode_ClearResetsCache) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    OrderCache arenaCache{OrderCache::Arena{}};
+    arenaCache.addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+    arenaCache.addOrder(Order{"OrdId2", "SecId1", "Sell", 400, "User2", "CompanyB"});
+    ASSERT_EQ(arenaCache.getMatchingSizeForSecurity("SecId1"), 400);
+
+    arenaCache.clear();
+    ASSERT_TRUE(arenaCache.getAllOrders().empty());
+    ASSERT_EQ(arenaCache.getMatchingSizeForSecurity("SecId1"), 0);
+
+    // Ids of the previous session can be reused
+    EXPECT_NO_THROW(arenaCache.addOrder(Order{"OrdId1", "SecId1", "Sell", 300, "User3", "CompanyC"}));
+    arenaCache.addOrder(Order{"OrdId3", "SecId1", "Buy", 500, "User1", "CompanyA"});
+    ASSERT_EQ(arenaCache.getMatchingSizeForSecurity("SecId1"), 300);
+    ASSERT_EQ(arenaCache.getAllOrders().size(), 2);
+}
+
+// Allocation: Clearing many orders in arena mode leaves the same empty, reusable cache as the default mode
+TEST_F(OrderCacheTest, Allocation_ArenaMode_ClearManyOrdersLikeDefaultMode) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    std::vector<Order> orders = generateOrders(20000);
+    OrderCache arenaCache{OrderCache::Arena{}};
+    for (const auto& order : orders) {
+        cache.addOrder(order);
+        arenaCache.addOrder(order);
+    }
+    cache.clear();
+    arenaCache.clear();
+    ASSERT_TRUE(cache.getAllOrders().empty());
+    ASSERT_TRUE(arenaCache.getAllOrders().empty());
+
+    for (std::size_t i = 0; i < 2000; i++) {
+        cache.addOrder(orders[i]);
+        arenaCache.addOrder(orders[i]);
+    }
+    ASSERT_EQ(arenaCache.getAllOrders().size(), 2000);
+    for (const auto& secId : secIds) {
+        ASSERT_EQ(arenaCache.getMatchingSizeForSecurity(secId), cache.getMatchingSizeForSecurity(secId));
+    }
+}
+
+// WorkStealingPool: Every index of a skewed loop is run exactly once, whatever the thread count
+TEST_F(OrderCacheTest, WorkStealingPool_ParallelFor_RunsEveryIndexOnce) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    for (unsigned int threads : {1u, 2u, 3u, 8u}) {
+        WorkStealingPool pool(threads);
+        ASSERT_EQ(pool.size(), threads);
+        for (std::size_t count : {0, 1, 7, 1000}) {
+            std::vector<std::atomic<int>> runs(count);
+            pool.parallelFor(count, 3, [&runs](std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; i++) {
+                    // the first indexes are far more expensive than the rest
+                    volatile unsigned int spin = i < 10 ? 100000 : 10;
+                    while (spin) spin = spin - 1;
+                    runs[i]++;
+                }
+            });
+            for (std::size_t i = 0; i < count; i++) {
+                ASSERT_EQ(runs[i].load(), 1);
+            }
+        }
+    }
+}
+
+// BookFile: A saved book is served in place after loading and copied into the cache on the first change
+TEST_F(OrderCacheTest, BookFile_SaveAndLoad_ServesQueriesThenMaterializes) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    const std::string path = "OrderCacheTest_book.bin";
+    for (const auto& order : generateOrders(20000)) {
+        cache.addOrder(order);
+    }
+    cache.cancelOrdersForUser(users[0]);
+    cache.cancelOrdersForSecIdWithMinimumQty(secIds[1], 2000);
+    cache.saveBook(path);
+
+    OrderCache loaded;
+    loaded.addOrder(Order{"Stale", "SecId1", "Buy", 100, "User1", "CompanyA"});
+    loaded.loadBook(path);
+    ASSERT_TRUE(loaded.isMapped());
+
+    std::vector<Order> expected = cache.getAllOrders();
+    std::vector<Order> actual = loaded.getAllOrders();
+    ASSERT_EQ(actual.size(), expected.size());
+    for (std::size_t i = 0; i < actual.size(); i++) {
+        ASSERT_EQ(actual[i].orderId(), expected[i].orderId());
+        ASSERT_EQ(actual[i].securityId(), expected[i].securityId());
+        ASSERT_EQ(actual[i].side(), expected[i].side());
+        ASSERT_EQ(actual[i].qty(), expected[i].qty());
+        ASSERT_EQ(actual[i].user(), expected[i].user());
+        ASSERT_EQ(actual[i].company(), expected[i].company());
+    }
+    for (const auto& secId : secIds) {
+        ASSERT_EQ(loaded.getMatchingSizeForSecurity(secId), cache.getMatchingSizeForSecurity(secId));
+    }
+    ASSERT_EQ(loaded.getMatchingSizeForSecurity("Unknown"), 0);
+    std::vector<SecurityMatchingSize> sizes = loaded.getMatchingSizeForAllSecurities(2);
+    ASSERT_EQ(sizes.size(), cache.getMatchingSizeForAllSecurities(2).size());
+    for (const auto& size : sizes) {
+        ASSERT_EQ(size.matchingSize, cache.getMatchingSizeForSecurity(std::string(size.securityId)));
+    }
+    ASSERT_TRUE(loaded.isMapped());
+
+    // invalid calls and cancels that match nothing leave the book mapped
+    ASSERT_THROW(loaded.cancelOrdersForUser(""), std::invalid_argument);
+    ASSERT_THROW(loaded.cancelOrdersForSecIdWithMinimumQty("", 100), std::invalid_argument);
+    ASSERT_THROW(loaded.cancelOrdersForSecIdWithMinimumQty(secIds[0], 0), std::invalid_argument);
+    loaded.cancelOrdersForUser("Unknown");
+    loaded.cancelOrdersForSecIdWithMinimumQty("Unknown", 100);
+    ASSERT_TRUE(loaded.isMapped());
+
+    // the first change copies the book into the cache
+    ASSERT_THROW(loaded.addOrder(expected[0]), std::runtime_error);
+    ASSERT_FALSE(loaded.isMapped());
+    ASSERT_EQ(sizes[0].securityId, cache.getMatchingSizeForAllSecurities(1)[0].securityId);
+    loaded.cancelOrdersForUser(users[1]);
+    cache.cancelOrdersForUser(users[1]);
+    loaded.cancelOrder(expected[5].orderId());
+    cache.cancelOrder(expected[5].orderId());
+    for (const auto& secId : secIds) {
+        ASSERT_EQ(loaded.getMatchingSizeForSecurity(secId), cache.getMatchingSizeForSecurity(secId));
+    }
+    ASSERT_EQ(loaded.getAllOrders().size(), cache.getAllOrders().size());
+
+    std::remove(path.c_str());
+}
+
+// BookFile: Missing, damaged and newer book files are rejected and leave the cache unchanged
+TEST_F(OrderCacheTest, BookFile_InvalidFile_ThrowsException) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    const std::string path = "OrderCacheTest_bad_book.bin";
+    cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+    cache.addOrder(Order{"OrdId2", "SecId1", "Sell", 500, "User2", "CompanyB"});
+    cache.saveBook(path);
+
+    std::string image;
+    {
+        std::ifstream file(path, std::ios::binary);
+        image.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    auto writeImage = [&path](const std::string& bytes) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), bytes.size());
+    };
+
+    ASSERT_THROW(cache.loadBook("OrderCacheTest_missing_book.bin"), std::runtime_error);
+
+    writeImage(image.substr(0, image.size() - 4));
+    ASSERT_THROW(cache.loadBook(path), std::runtime_error);
+
+    std::string newer = image;
+    newer[8] = 2;
+    writeImage(newer);
+    ASSERT_THROW(cache.loadBook(path), std::runtime_error);
+
+    std::string garbage(image.size(), 'x');
+    writeImage(garbage);
+    ASSERT_THROW(cache.loadBook(path), std::runtime_error);
+
+    ASSERT_FALSE(cache.isMapped());
+    ASSERT_EQ(cache.getAllOrders().size(), 2);
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 500);
+
+    std::remove(path.c_str());
+}
+
+// BookFile: A restored book answers the matching sizes of the cache that saved it, before and after its first change
+TEST_F(OrderCacheTest, BookFile_Restore_MatchesCacheThatSavedIt) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    const std::string path = "OrderCacheTest_restore_book.bin";
+    std::vector<Order> orders = generateOrders(20000);
+    for (const auto& order : orders) {
+        cache.addOrder(order);
+    }
+    cache.saveBook(path);
+
+    OrderCache restored;
+    restored.loadBook(path);
+    for (const auto& secId : secIds) {
+        ASSERT_EQ(restored.getMatchingSizeForSecurity(secId), cache.getMatchingSizeForSecurity(secId));
+    }
+
+    restored.cancelOrder(orders[0].orderId());
+    cache.cancelOrder(orders[0].orderId());
+    ASSERT_FALSE(restored.isMapped());
+    ASSERT_EQ(restored.getAllOrders().size(), orders.size() - 1);
+    for (const auto& secId : secIds) {
+        ASSERT_EQ(restored.getMatchingSizeForSecurity(secId), cache.getMatchingSizeForSecurity(secId));
+    }
+    std::remove(path.c_str());
+}
+
+// Journal: Replaying a journal rebuilds the cache that wrote it
+TEST_F(OrderCacheTest, Journal_Replay_RebuildsCache) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    const std::string path = "OrderCacheTest_journal.bin";
+    std::remove(path.c_str());
+    std::vector<Order> orders = generateOrders(20000);
+    {
+        OrderJournal journal(path);
+        cache.setJournal(&journal);
+        for (std::size_t i = 0; i < 10000; i++) {
+            cache.addOrder(orders[i]);
+        }
+        cache.addOrders(std::vector<Order>(orders.begin() + 10000, orders.end()));
+        ASSERT_THROW(cache.addOrder(orders[0]), std::runtime_error);
+        for (std::size_t i = 0; i < orders.size(); i += 5) {
+            cache.cancelOrder(orders[i].orderId());
+        }
+        cache.cancelOrder("Unknown");
+        cache.cancelOrdersForUser(users[3]);
+        cache.cancelOrdersForSecIdWithMinimumQty(secIds[4], 2000);
+        cache.addOrder(orders[0]);
+        journal.flush();
+        cache.setJournal(nullptr);
+    }
+
+    OrderCache replayed;
+    ASSERT_EQ(OrderJournal::replay(path, replayed), orders.size() + orders.size() / 5 + 3);
+    ASSERT_EQ(replayed.getAllOrders().size(), cache.getAllOrders().size());
+    for (const auto& secId : secIds) {
+        ASSERT_EQ(replayed.getMatchingSizeForSecurity(secId), cache.getMatchingSizeForSecurity(secId));
+    }
+    std::remove(path.c_str());
+}
+
+// Journal: Journals written with and without sync replay every change to the same cache
+TEST_F(OrderCacheTest, Journal_SyncModes_ReplayEveryChange) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    const std::string path = "OrderCacheTest_sync_journal.bin";
+    std::vector<Order> orders = generateOrders(20000);
+    for (bool sync : { false, true }) {
+        std::remove(path.c_str());
+        OrderCache target;
+        {
+            OrderJournal journal(path, sync);
+            target.setJournal(&journal);
+            for (const auto& order : orders) {
+                target.addOrder(order);
+            }
+            for (std::size_t i = 0; i < orders.size(); i += 2) {
+                target.cancelOrder(orders[i].orderId());
+            }
+            journal.flush();
+            target.setJournal(nullptr);
+        }
+
+        OrderCache replayed;
+        ASSERT_EQ(OrderJournal::replay(path, replayed), orders.size() * 3 / 2);
+        ASSERT_EQ(replayed.getAllOrders().size(), orders.size() / 2);
+        for (const auto& secId : secIds) {
+            ASSERT_EQ(replayed.getMatchingSizeForSecurity(secId), target.getMatchingSizeForSecurity(secId));
+        }
+    }
+    std::remove(path.c_str());
+}
+
+// Journal: Executed matches replay as their fills, also onto a cache restored from the book file the journal started on
+TEST_F(OrderCacheTest, Journal_ExecuteMatches_ReplaysFills) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    const std::string bookPath = "OrderCacheTest_fills_book.bin";
+    const std::string path = "OrderCacheTest_fills_journal.bin";
+    std::remove(path.c_str());
+    std::vector<Order> orders = generateOrders(20000);
+    auto openQty = [](OrderCache& target) {
+        std::map<std::string, unsigned int> qty;
+        for (const auto& order : target.getAllOrders()) {
+            qty[order.orderId()] = order.qty();
+        }
+        return qty;
+    };
+
+    // half the orders come from the book file, the rest are added in one batch
+    for (std::size_t i = 0; i < 10000; i++) {
+        cache.addOrder(orders[i]);
+    }
+    cache.saveBook(bookPath);
+    OrderCache restored;
+    restored.loadBook(bookPath);
+    {
+        OrderJournal journal(path);
+        restored.setJournal(&journal);
+        restored.addOrders(std::vector<Order>(orders.begin() + 10000, orders.end()));
+        restored.cancelOrdersForSecIdWithMinimumQty(secIds[2], 5000);
+        FillBuffer fills;
+        unsigned long long executed = 0;
+        for (const auto& secId : secIds) {
+            executed += restored.executeMatches(secId, fills);
+        }
+        ASSERT_GT(executed, 0);
+        journal.flush();
+        restored.setJournal(nullptr);
+    }
+
+    OrderCache replayed;
+    replayed.loadBook(bookPath);
+    OrderJournal::replay(path, replayed);
+    ASSERT_EQ(openQty(replayed), openQty(restored));
+    for (const auto& secId : secIds) {
+        ASSERT_EQ(replayed.getMatchingSizeForSecurity(secId), restored.getMatchingSizeForSecurity(secId));
+    }
+    std::remove(path.c_str());
+    std::remove(bookPath.c_str());
+}
+
+// Journal: A record cut short by a crash is dropped and the journal can be appended to again
+TEST_F(OrderCacheTest, Journal_TornTail_IsDroppedOnOpen) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    const std::string path = "OrderCacheTest_torn_journal.bin";
+    std::remove(path.c_str());
+    {
+        OrderJournal journal(path);
+        cache.setJournal(&journal);
+        cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+        cache.addOrder(Order{"OrdId2", "SecId1", "Sell", 500, "User2", "CompanyB"});
+        journal.flush();
+        cache.setJournal(nullptr);
+    }
+    std::size_t size = std::filesystem::file_size(path);
+    std::filesystem::resize_file(path, size - 3);
+
+    OrderCache partial;
+    ASSERT_EQ(OrderJournal::replay(path, partial), 1);
+    ASSERT_EQ(partial.getAllOrders().size(), 1);
+    {
+        OrderJournal journal(path);
+        ASSERT_LT(std::filesystem::file_size(path), size - 3);
+        partial.setJournal(&journal);
+        partial.addOrder(Order{"OrdId3", "SecId1", "Sell", 700, "User3", "CompanyC"});
+        journal.flush();
+        partial.setJournal(nullptr);
+    }
+    OrderCache replayed;
+    ASSERT_EQ(OrderJournal::replay(path, replayed), 2);
+    ASSERT_EQ(replayed.getMatchingSizeForSecurity("SecId1"), 700);
+
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << "not a journal";
+    ASSERT_THROW(OrderJournal journal(path), std::runtime_error);
+    ASSERT_THROW(OrderJournal::replay(path, replayed), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+// Journal: clear() and loadBook() are journaled, so a replay across them rebuilds the same book
+TEST_F(OrderCacheTest, Journal_ClearAndLoadBook_Replay) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    const std::string bookPath = "OrderCacheTest_journal_book.bin";
+    const std::string path = "OrderCacheTest_clear_journal.bin";
+    std::remove(path.c_str());
+    std::vector<Order> orders = generateOrders(3000);
+    OrderCache saved;
+    for (std::size_t i = 0; i < 1000; i++) {
+        saved.addOrder(orders[i]);
+    }
+    saved.saveBook(bookPath);
+    {
+        OrderJournal journal(path);
+        cache.setJournal(&journal);
+        for (std::size_t i = 1000; i < 2000; i++) {
+            cache.addOrder(orders[i]);
+        }
+        cache.clear();
+        cache.addOrder(orders[2000]);
+        cache.loadBook(bookPath);
+        for (std::size_t i = 2001; i < orders.size(); i++) {
+            cache.addOrder(orders[i]);
+        }
+        cache.cancelOrder(orders[0].orderId());
+        journal.flush();
+        cache.setJournal(nullptr);
+    }
+
+    OrderCache replayed;
+    OrderJournal::replay(path, replayed);
+    std::map<std::string, unsigned int> expected, actual;
+    for (const auto& order : cache.getAllOrders()) {
+        expected[order.orderId()] = order.qty();
+    }
+    for (const auto& order : replayed.getAllOrders()) {
+        actual[order.orderId()] = order.qty();
+    }
+    ASSERT_EQ(actual.size(), 1998);
+    ASSERT_EQ(actual, expected);
+    std::remove(path.c_str());
+    std::remove(bookPath.c_str());
+}
+
+// Journal: After a failed write the journal writes nothing more and rejects changes before they are applied
+TEST_F(OrderCacheTest, Journal_WriteFailure_RejectsLaterChanges) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+    if (!std::filesystem::exists("/dev/full")) {
+        GTEST_SKIP() << "needs /dev/full";
+    }
+
+    cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+    cache.addOrder(Order{"OrdId2", "SecId1", "Sell", 500, "User2", "CompanyB"});
+    OrderJournal journal("/dev/full", false);
+    cache.setJournal(&journal);
+    // the file header is the first write and fails
+    ASSERT_THROW(journal.flush(), std::runtime_error);
+
+    ASSERT_THROW(cache.addOrder(Order{"OrdId3", "SecId1", "Sell", 500, "User2", "CompanyB"}), std::runtime_error);
+    ASSERT_THROW(cache.addOrders({ Order{"OrdId4", "SecId1", "Sell", 500, "User2", "CompanyB"} }), std::runtime_error);
+    ASSERT_THROW(cache.cancelOrder("OrdId1"), std::runtime_error);
+    ASSERT_THROW(cache.clear(), std::runtime_error);
+    ASSERT_EQ(cache.getAllOrders().size(), 2);
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 500);
+
+    // the rejected ids were released
+    cache.setJournal(nullptr);
+    cache.addOrder(Order{"OrdId3", "SecId1", "Sell", 200, "User2", "CompanyB"});
+    cache.addOrders({ Order{"OrdId4", "SecId1", "Sell", 100, "User2", "CompanyB"} });
+    ASSERT_EQ(cache.getAllOrders().size(), 4);
+}
+
+// OrderFile: Loading a text order file reports bad lines by number and adds the rest like addOrder
+TEST_F(OrderCacheTest, OrderFile_Load_ReportsBadLinesAndMatchesAddOrder) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    const std::string path = "OrderCacheTest_orders.txt";
+    std::ofstream(path, std::ios::binary | std::ios::trunc)
+        << "OrdId1 SecId1 Buy 1000 User1 CompanyA\n"
+        << "\n"
+        << "  OrdId2  SecId1\tSell 500 User2 CompanyB\r\n"
+        << "OrdId3 SecId1 Hold 100 User3 CompanyC\n"
+        << "OrdId4 SecId1 Sell 12x User3 CompanyC\n"
+        << "OrdId5 SecId1 Sell 100 User3\n"
+        << "OrdId1 SecId1 Sell 100 User3 CompanyC\n"
+        << "OrdId6 SecId1 Sell 0 User3 CompanyC\n"
+        << "OrdId7 SecId1 Sell 300 User3 CompanyC Extra\n"
+        << "OrdId8 SecId2 Buy 4294967296 User1 CompanyA\n"
+        << "OrdId9 SecId2 Sell 200 User4 CompanyB";
+
+    std::vector<BatchError> errors = cache.loadOrderFile(path, 2);
+    std::vector<std::pair<std::size_t, OrderError>> expected = {
+        { 3, OrderError::InvalidSide }, { 4, OrderError::MalformedLine }, { 5, OrderError::MalformedLine },
+        { 6, OrderError::DuplicateOrderId }, { 7, OrderError::ZeroQty }, { 8, OrderError::MalformedLine },
+        { 9, OrderError::MalformedLine } };
+    ASSERT_EQ(errors.size(), expected.size());
+    for (std::size_t i = 0; i < errors.size(); i++) {
+        ASSERT_EQ(errors[i].index, expected[i].first);
+        ASSERT_EQ(errors[i].error, expected[i].second);
+    }
+    std::vector<Order> loaded = cache.getAllOrders();
+    ASSERT_EQ(loaded.size(), 3);
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 500);
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId2"), 0);
+    for (const auto& order : loaded) {
+        if (order.orderId() == "OrdId2") {
+            ASSERT_EQ(order.company(), "CompanyB");
+        }
+    }
+
+    // large enough for several chunks, so lines are numbered across chunk boundaries
+    std::vector<Order> orders = generateOrders(200000);
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        for (const auto& order : orders) {
+            file << order.orderId() << ' ' << order.securityId() << ' ' << order.side() << ' ' << order.qty()
+                << ' ' << order.user() << ' ' << order.company() << '\n';
+        }
+        file << orders[123456].orderId() << " SecId1 Buy 1 User1 CompanyA\n";
+    }
+    OrderCache reference;
+    for (const auto& order : orders) {
+        reference.addOrder(order);
+    }
+    OrderCache fromFile;
+    errors = fromFile.loadOrderFile(path, 4);
+    ASSERT_EQ(errors.size(), 1);
+    ASSERT_EQ(errors[0].index, orders.size());
+    ASSERT_EQ(errors[0].error, OrderError::DuplicateOrderId);
+    ASSERT_EQ(fromFile.getAllOrders().size(), orders.size());
+    for (const auto& secId : secIds) {
+        ASSERT_EQ(fromFile.getMatchingSizeForSecurity(secId), reference.getMatchingSizeForSecurity(secId));
+    }
+    std::remove(path.c_str());
+    ASSERT_THROW(fromFile.loadOrderFile(path), std::runtime_error);
+}
+
+// Stats: The histogram buckets values to within 1/16 and reports percentiles, extremes and mean
+TEST_F(OrderCacheTest, Stats_LatencyHistogram_Percentiles) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    LatencyHistogram histogram;
+    ASSERT_EQ(histogram.percentile(0.5), 0);
+    for (std::uint64_t value = 1; value <= 100000; value++) {
+        histogram.record(value);
+    }
+    ASSERT_EQ(histogram.count(), 100000);
+    ASSERT_EQ(histogram.min(), 1);
+    ASSERT_EQ(histogram.max(), 100000);
+    ASSERT_DOUBLE_EQ(histogram.mean(), 50000.5);
+    for (double fraction : {0.5, 0.9, 0.99, 0.999}) {
+        double exact = fraction * 100000;
+        ASSERT_GE(histogram.percentile(fraction), exact);
+        ASSERT_LE(histogram.percentile(fraction), exact * 17 / 16);
+    }
+    ASSERT_EQ(histogram.percentile(1.0), 100000);
+
+    for (std::uint64_t value : {0ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull, 1ull << 40}) {
+        std::size_t index = LatencyHistogram::bucketIndex(value);
+        ASSERT_LT(index, LatencyHistogram::BUCKET_COUNT);
+        ASSERT_GE(LatencyHistogram::bucketUpperBound(index), value);
+        if (index) {
+            ASSERT_LT(LatencyHistogram::bucketUpperBound(index - 1), value);
+        }
+    }
+
+    LatencyHistogram merged = histogram;
+    merged += histogram;
+    ASSERT_EQ(merged.count(), 200000);
+    ASSERT_EQ(merged.percentile(0.5), histogram.percentile(0.5));
+}
+
+// Stats: The cache counts adds, cancels and executed qty, times every public method and tracks book depth
+TEST_F(OrderCacheTest, Stats_Snapshot_CountsAndTimesOperations) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+    cache.addOrder(Order{"OrdId2", "SecId1", "Sell", 600, "User2", "CompanyB"});
+    cache.addOrder(Order{"OrdId3", "SecId1", "Sell", 300, "User2", "CompanyB"});
+    cache.addOrder(Order{"OrdId4", "SecId2", "Buy", 500, "User3", "CompanyA"});
+    ASSERT_THROW(cache.addOrder(Order{"OrdId1", "SecId2", "Buy", 500, "User3", "CompanyA"}), std::runtime_error);
+    cache.addOrders({ Order{"OrdId5", "SecId2", "Sell", 500, "User3", "CompanyB"}
+        , Order{"", "SecId2", "Sell", 500, "User3", "CompanyB"} });
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 900);
+    cache.getMatchingSizeForAllSecurities(1);
+    cache.cancelOrder("OrdId3");
+    cache.cancelOrder("Unknown");
+    cache.cancelOrdersForUser("User3");
+    cache.cancelOrdersForSecIdWithMinimumQty("SecId1", 100);
+    cache.getAllOrders();
+    cache.getCompanyExposure("SecId1", "CompanyA");
+    cache.getCompanyExposure("CompanyA");
+    cache.getCompanyExposures("SecId1");
+
+    OrderCacheStats stats = cache.stats();
+    ASSERT_EQ(stats.ordersAdded, 5);
+    ASSERT_EQ(stats.ordersCancelled, 5);
+    ASSERT_EQ(stats.executedQty, 0);
+    ASSERT_EQ(stats[StatsMethod::AddOrder].count(), 5);
+    ASSERT_EQ(stats[StatsMethod::AddOrders].count(), 1);
+    ASSERT_EQ(stats[StatsMethod::CancelOrder].count(), 2);
+    ASSERT_EQ(stats[StatsMethod::CancelOrdersForUser].count(), 1);
+    ASSERT_EQ(stats[StatsMethod::CancelOrdersForSecIdWithMinimumQty].count(), 1);
+    ASSERT_EQ(stats[StatsMethod::GetMatchingSizeForSecurity].count(), 1);
+    ASSERT_EQ(stats[StatsMethod::GetMatchingSizeForAllSecurities].count(), 1);
+    ASSERT_EQ(stats[StatsMethod::GetAllOrders].count(), 1);
+    ASSERT_EQ(stats[StatsMethod::GetCompanyExposure].count(), 2);
+    ASSERT_EQ(stats[StatsMethod::GetCompanyExposures].count(), 1);
+    ASSERT_GT(stats[StatsMethod::AddOrder].max(), 0);
+    ASSERT_STREQ(statsMethodName(StatsMethod::GetAllOrders), "getAllOrders");
+
+    ASSERT_EQ(stats.maxDepth.size(), 2);
+    ASSERT_EQ(stats.maxDepth[0].securityId, "SecId1");
+    ASSERT_EQ(stats.maxDepth[0].maxDepth, 3);
+    ASSERT_EQ(stats.maxDepth[1].securityId, "SecId2");
+    ASSERT_EQ(stats.maxDepth[1].maxDepth, 2);
+
+    // counters survive clear(), the depths belong to the securities cleared
+    cache.clear();
+    stats = cache.stats();
+    ASSERT_EQ(stats.ordersAdded, 5);
+    ASSERT_TRUE(stats.maxDepth.empty());
+
+    // only executed qty counts as matched, the queries above added nothing
+    cache.addOrder(Order{"OrdId6", "SecId3", "Buy", 200, "User1", "CompanyA"});
+    cache.addOrder(Order{"OrdId7", "SecId3", "Sell", 150, "User2", "CompanyB"});
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId3"), 150);
+    FillBuffer fills;
+    ASSERT_EQ(cache.executeMatches("SecId3", fills), 150);
+    stats = cache.stats();
+    ASSERT_EQ(stats.ordersFilled, 1);
+    ASSERT_EQ(stats.executedQty, 150);
+    ASSERT_EQ(stats[StatsMethod::ExecuteMatches].count(), 1);
+
+    ConcurrentOrderCache concurrent(4);
+    concurrent.addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+    concurrent.addOrder(Order{"OrdId2", "SecId2", "Sell", 600, "User2", "CompanyB"});
+    concurrent.cancelOrder("OrdId2");
+    stats = concurrent.stats();
+    ASSERT_EQ(stats.ordersAdded, 2);
+    ASSERT_EQ(stats.ordersCancelled, 1);
+    ASSERT_EQ(stats.maxDepth.size(), 2);
+}
+
+// Stats: The collecting policy times calls and keeps its counters outside a cache
+TEST_F(OrderCacheTest, Stats_CollectStats_RecordsTimersAndCounters) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    CollectStats collect;
+    {
+        auto timer = collect.time(StatsMethod::AddOrder);
+    }
+    {
+        auto timer = collect.time(StatsMethod::ExecuteMatches);
+    }
+    collect.ordersAdded(3);
+    collect.ordersCancelled(1);
+    collect.ordersFilled(2);
+    collect.executed(700);
+    collect.depth(1, 4);
+    collect.depth(1, 2);
+
+    OrderCacheStats stats;
+    collect.copyTo(stats);
+    ASSERT_EQ(stats[StatsMethod::AddOrder].count(), 1);
+    ASSERT_EQ(stats[StatsMethod::ExecuteMatches].count(), 1);
+    ASSERT_EQ(stats[StatsMethod::CancelOrder].count(), 0);
+    ASSERT_EQ(stats.ordersAdded, 3);
+    ASSERT_EQ(stats.ordersCancelled, 1);
+    ASSERT_EQ(stats.ordersFilled, 2);
+    ASSERT_EQ(stats.executedQty, 700);
+    ASSERT_EQ(stats.maxDepth.size(), 2);
+    ASSERT_EQ(stats.maxDepth[0].maxDepth, 0);
+    ASSERT_EQ(stats.maxDepth[1].maxDepth, 4);
+    ASSERT_STREQ(statsMethodName(StatsMethod::ExecuteMatches), "executeMatches");
+}
+
+// Stats: A cache without stats behaves like one with them and reports nothing
+TEST_F(OrderCacheTest, Stats_NoStats_ReportsEmptyStats) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    BasicOrderCache<StringOrderIds, NoStats> quiet;
+    for (auto* target : std::initializer_list<OrderCacheInterface*>{&cache, &quiet}) {
+        target->addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+        target->addOrder(Order{"OrdId2", "SecId1", "Sell", 600, "User2", "CompanyB"});
+        target->addOrder(Order{"OrdId3", "SecId2", "Sell", 300, "User2", "CompanyB"});
+        target->cancelOrder("OrdId3");
+    }
+    ASSERT_EQ(quiet.getMatchingSizeForSecurity("SecId1"), cache.getMatchingSizeForSecurity("SecId1"));
+    ASSERT_EQ(quiet.getAllOrders().size(), cache.getAllOrders().size());
+    FillBuffer fills;
+    ASSERT_EQ(quiet.executeMatches("SecId1", fills), 600);
+
+    OrderCacheStats stats = quiet.stats();
+    ASSERT_EQ(stats.ordersAdded, 0);
+    ASSERT_EQ(stats.ordersCancelled, 0);
+    ASSERT_EQ(stats.executedQty, 0);
+    ASSERT_EQ(stats[StatsMethod::AddOrder].count(), 0);
+    ASSERT_EQ(stats[StatsMethod::ExecuteMatches].count(), 0);
+    ASSERT_TRUE(stats.maxDepth.empty());
+    ASSERT_EQ(cache.stats().ordersAdded, 3);
+}
+
+// FlatHashMap: Random inserts, lookups and erases agree with std::unordered_map, tombstones included
+TEST_F(OrderCacheTest, FlatHashMap_RandomOperations_MatchUnorderedMap) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    std::deque<std::string> keys;
+    for (int i = 0; i < 20000; i++) {
+        keys.push_back("Key" + std::to_string(i));
+    }
+    FlatHashMap<std::string_view, unsigned int> map;
+    std::unordered_map<std::string, unsigned int> reference;
+    std::uniform_int_distribution<std::size_t> keyDist(0, keys.size() - 1);
+    std::uniform_int_distribution<int> opDist(0, 2);
+    for (int step = 0; step < 300000; step++) {
+        const std::string& key = keys[keyDist(gen)];
+        switch (opDist(gen)) {
+            case 0: {
+                auto result = map.tryEmplace(key, step);
+                auto expected = reference.try_emplace(key, step);
+                ASSERT_EQ(result.second, expected.second);
+                ASSERT_EQ(*result.first, expected.first->second);
+                break;
+            }
+            case 1:
+                ASSERT_EQ(map.erase(key), reference.erase(key) == 1);
+                break;
+            default: {
+                const unsigned int* value = map.find(key);
+                auto it = reference.find(key);
+                ASSERT_EQ(value != nullptr, it != reference.end());
+                if (value) {
+                    ASSERT_EQ(*value, it->second);
+                }
+            }
+        }
+        ASSERT_EQ(map.size(), reference.size());
+    }
+
+    std::size_t visited = 0;
+    map.forEach([&](std::string_view key, unsigned int value) {
+        ASSERT_EQ(reference.at(std::string(key)), value);
+        visited++;
+    });
+    ASSERT_EQ(visited, reference.size());
+    ASSERT_FALSE(map.contains("Missing"));
+
+    // lookups go through the string_view, the std::string is not copied
+    std::string probe = "Key" + std::to_string(keys.size() + 1);
+    ASSERT_TRUE(map.tryEmplace(probe, 7).second);
+    ASSERT_TRUE(map.contains(std::string_view(probe)));
+
+    FlatHashMap<std::string_view, unsigned int> moved(std::move(map));
+    ASSERT_EQ(moved.size(), reference.size() + 1);
+    ASSERT_EQ(map.size(), 0);
+    ASSERT_EQ(map.find(probe), nullptr);
+
+    FlatHashMap<unsigned int, unsigned int, IntegerHash> ids;
+    ids.reserve(1000);
+    std::size_t capacity = ids.capacity();
+    for (unsigned int i = 0; i < 1000; i++) {
+        ids.tryEmplace(i, i * 2);
+    }
+    ASSERT_EQ(ids.capacity(), capacity);
+    for (unsigned int i = 0; i < 1000; i++) {
+        ASSERT_EQ(*ids.find(i), i * 2);
+    }
+    ids.clear();
+    ASSERT_TRUE(ids.empty());
+    ASSERT_EQ(ids.find(3), nullptr);
+}
+
+// FixedString: Ids up to N chars are stored word-padded, compared and hashed by value, and longer ones are refused
+TEST_F(OrderCacheTest, FixedString_AssignCompareHash_ByValue) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+    static_assert(std::is_trivially_copyable<FixedString<16>>::value, "FixedString must be trivially copyable");
+    static_assert(sizeof(FixedString<15>) == 16 && sizeof(FixedString<16>) == 24, "size byte follows the chars");
+
+    FixedString<16> a, b, empty;
+    ASSERT_TRUE(empty.empty());
+    ASSERT_TRUE(a.assign("OrdId1"));
+    ASSERT_TRUE(b.assign(std::string("OrdId1")));
+    ASSERT_EQ(std::string_view(a), "OrdId1");
+    ASSERT_EQ(a.size(), 6);
+    ASSERT_TRUE(a == b);
+    ASSERT_EQ(std::hash<FixedString<16>>()(a), std::hash<FixedString<16>>()(b));
+
+    // a shorter value leaves no chars of the longer one behind
+    ASSERT_TRUE(b.assign("OrdId12"));
+    ASSERT_TRUE(b.assign("OrdId"));
+    ASSERT_TRUE(a.assign("OrdId"));
+    ASSERT_TRUE(a == b);
+
+    // the size tells apart ids that differ only by trailing zero chars
+    ASSERT_TRUE(b.assign(std::string_view("OrdId\0", 6)));
+    ASSERT_TRUE(a != b);
+
+    ASSERT_TRUE(a.assign("0123456789abcdef"));
+    ASSERT_FALSE(a.assign("0123456789abcdefg"));
+    ASSERT_EQ(std::string_view(a), "0123456789abcdef");
+
+    FixedString<16> copy;
+    std::memcpy(&copy, &a, sizeof(a));
+    ASSERT_TRUE(copy == a);
+
+    // distinct ids spread over the low hash bits the flat map probes with
+    std::set<std::size_t> groups;
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_TRUE(a.assign("OrdId" + std::to_string(i)));
+        groups.insert(std::hash<FixedString<16>>()(a) & 0x7F);
+    }
+    ASSERT_EQ(groups.size(), 128);
+}
+
+// FixedString: With a fixed order id policy, ids longer than the policy allows are rejected
+TEST_F(OrderCacheTest, FixedString_OrderCache_RejectsLongOrderIds) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    using FixedOrderCache = BasicOrderCache<FixedOrderIds<16>>;
+    FixedOrderCache fixedCache;
+    std::string longId(17, 'X');
+    std::string maxId(16, 'X');
+    ASSERT_THROW(fixedCache.addOrder(Order{longId, "SecId1", "Buy", 100, "User1", "CompanyA"}), std::invalid_argument);
+    fixedCache.addOrder(Order{maxId, "SecId1", "Buy", 100, "User1", "CompanyA"});
+    fixedCache.addOrder(Order{"OrdId1", "SecId1", "Sell", 100, "User2", "CompanyB"});
+
+    std::vector<Order> batch = { Order{longId, "SecId1", "Sell", 100, "User2", "CompanyB"} };
+    std::vector<BatchError> errors = fixedCache.addOrders(std::move(batch));
+    ASSERT_EQ(errors.size(), 1);
+    ASSERT_EQ(errors[0].error, OrderError::OrderIdTooLong);
+
+    fixedCache.cancelOrder(longId);
+    ASSERT_EQ(fixedCache.getAllOrders().size(), 2);
+    ASSERT_EQ(fixedCache.getMatchingSizeForSecurity("SecId1"), 100);
+    fixedCache.cancelOrder(maxId);
+    ASSERT_EQ(fixedCache.getAllOrders().size(), 1);
+    ASSERT_EQ(fixedCache.getAllOrders()[0].orderId(), "OrdId1");
+
+    // the string id cache in the same binary takes the long id
+    cache.addOrder(Order{longId, "SecId1", "Buy", 100, "User1", "CompanyA"});
+    ASSERT_EQ(cache.getAllOrders().size(), 1);
+}
+
+// FixedString: A cache with fixed order ids ends up in the same state as one with string ids
+TEST_F(OrderCacheTest, FixedString_OrderCache_MatchesStringOrderIds) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    BasicOrderCache<FixedOrderIds<16>> fixedCache;
+    auto apply = [](auto& target, unsigned int op, const Order& order) {
+        switch (op) {
+        case 0:
+            target.cancelOrder(order.orderId());
+            break;
+        case 1:
+            target.cancelOrdersForUser(order.user());
+            break;
+        case 2:
+            target.cancelOrdersForSecIdWithMinimumQty(order.securityId(), order.qty());
+            break;
+        default:
+            try {
+                target.addOrder(order);
+            } catch (const std::runtime_error&) {
+                // duplicate id, rejected by both caches
+            }
+        }
+    };
+    std::mt19937 rng(42);
+    for (int i = 0; i < 5000; i++) {
+        unsigned int op = rng() % 6;
+        Order order{"OrdId" + std::to_string(rng() % 1000), secIds[rng() % secIds.size()], rng() % 2 ? "Buy" : "Sell",
+                    static_cast<unsigned int>(100 + rng() % 900), users[rng() % users.size()],
+                    companies[rng() % companies.size()]};
+        apply(cache, op, order);
+        apply(fixedCache, op, order);
+    }
+
+    auto byId = [](std::vector<Order> orders) {
+        std::sort(orders.begin(), orders.end(),
+                  [](const Order& a, const Order& b) { return a.orderId() < b.orderId(); });
+        return orders;
+    };
+    std::vector<Order> expected = byId(cache.getAllOrders());
+    std::vector<Order> actual = byId(fixedCache.getAllOrders());
+    ASSERT_FALSE(expected.empty());
+    ASSERT_EQ(actual.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(actual[i].orderId(), expected[i].orderId());
+        ASSERT_EQ(actual[i].securityId(), expected[i].securityId());
+        ASSERT_EQ(actual[i].side(), expected[i].side());
+        ASSERT_EQ(actual[i].qty(), expected[i].qty());
+        ASSERT_EQ(actual[i].user(), expected[i].user());
+        ASSERT_EQ(actual[i].company(), expected[i].company());
+    }
+    for (const std::string& secId : secIds) {
+        ASSERT_EQ(fixedCache.getMatchingSizeForSecurity(secId), cache.getMatchingSizeForSecurity(secId));
+    }
+}
+
+// Allocation: Once the cache has grown, an add allocates nothing, with no hidden copies
+TEST_F(OrderCacheTest, Allocation_EmplaceOrder_AllocatesNothingOnceGrown) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    const std::size_t NUM_ORDERS = 10000;
+    std::vector<std::string> orderIds;
+    for (std::size_t i = 0; i < NUM_ORDERS; i++) {
+        orderIds.push_back("OrdId" + std::to_string(i));
+    }
+    // names past the small string buffer, so any std::string copy of them would allocate
+    std::string longUser = "UserWithAVeryLongName";
+    std::string longCompany = "CompanyWithAVeryLongName";
+
+    CountingResource resource;
+    OrderCache countedCache(&resource);
+    auto addAll = [&](auto add) {
+        for (std::size_t i = 0; i < NUM_ORDERS; i++) {
+            add(i, secIds[i % 100], sides[i % 2], static_cast<unsigned int>(100 + i % 1000)
+                , i % 2 ? longUser : users[i % 10], i % 3 ? longCompany : companies[i % 10]);
+        }
+    };
+    auto cancelAll = [&] {
+        for (const auto& id : orderIds) {
+            countedCache.cancelOrder(id);
+        }
+        ASSERT_TRUE(countedCache.getAllOrders().empty());
+    };
+
+    // the first round grows the columns, indexes and symbol tables
+    addAll([&](std::size_t i, const std::string& secId, const std::string& side, unsigned int qty
+        , const std::string& user, const std::string& company) {
+        countedCache.emplaceOrder(orderIds[i], secId, side, qty, user, company);
+    });
+    cancelAll();
+
+    // per add: allocations from the cache's resource and from anywhere in the process
+    auto measure = [&](auto add) {
+        std::size_t resourceBefore = resource.allocations;
+        std::size_t heapBefore = heapAllocations.load();
+        addAll(add);
+        std::pair<double, double> perAdd(static_cast<double>(resource.allocations - resourceBefore) / NUM_ORDERS
+            , static_cast<double>(heapAllocations.load() - heapBefore) / NUM_ORDERS);
+        cancelAll();
+        return perAdd;
+    };
+    auto emplaced = measure([&](std::size_t i, const std::string& secId, const std::string& side, unsigned int qty
+        , const std::string& user, const std::string& company) {
+        countedCache.emplaceOrder(orderIds[i], secId, side, qty, user, company);
+    });
+
+    std::vector<Order> orders;
+    addAll([&](std::size_t i, const std::string& secId, const std::string& side, unsigned int qty
+        , const std::string& user, const std::string& company) {
+        orders.push_back(Order{orderIds[i], secId, side, qty, user, company});
+    });
+    auto moved = measure([&](std::size_t i, const std::string&, const std::string&, unsigned int
+        , const std::string&, const std::string&) {
+        countedCache.addOrder(std::move(orders[i]));
+    });
+
+    std::cout << BLUE_COLOR << "[     INFO ] Allocations per add, cache resource / whole process: emplaceOrder "
+        << emplaced.first << " / " << emplaced.second << ", addOrder(std::move(order)) " << moved.first << " / "
+        << moved.second << RESET_COLOR << std::endl;
+
+    // at most a rehash of the order index dropping the tombstones of the cancels
+    ASSERT_LE(emplaced.first, 0.001);
+    ASSERT_LE(moved.first, 0.001);
+    // nothing is allocated outside the resource, which allocates from the heap itself
+    ASSERT_EQ(emplaced.second, emplaced.first);
+    ASSERT_EQ(moved.second, moved.first);
+
+    ASSERT_THROW(countedCache.emplaceOrder("OrdId1", "SecId1", "", 100, "User1", "CompanyA"), std::invalid_argument);
+    ASSERT_THROW(countedCache.emplaceOrder("OrdId1", "SecId1", "Hold", 100, "User1", "CompanyA"), std::invalid_argument);
+    ASSERT_THROW(countedCache.emplaceOrder("OrdId1", "SecId1", "Buy", 0, "User1", "CompanyA"), std::invalid_argument);
+    countedCache.emplaceOrder("OrdId1", "SecId1", "Buy", 100, "User1", "CompanyA");
+    ASSERT_THROW(countedCache.emplaceOrder("OrdId1", "SecId1", "Sell", 100, "User2", "CompanyB"), std::runtime_error);
+    countedCache.emplaceOrder("OrdId2", "SecId1", "Sell", 60, "User2", "CompanyB");
+    ASSERT_EQ(countedCache.getMatchingSizeForSecurity("SecId1"), 60);
+
+    // an order with several errors reports the same first one either way
+    auto firstError = [&](auto&& add) -> std::string {
+        try {
+            add();
+        } catch (const std::exception& e) {
+            return e.what();
+        }
+        return "";
+    };
+    for (const char* side : { "", "Hold" }) {
+        std::string emplaced = firstError([&] { countedCache.emplaceOrder("OrdId3", "SecId1", side, 0, "User1", "CompanyA"); });
+        std::string added = firstError([&] { countedCache.addOrder(Order{"OrdId3", "SecId1", side, 0, "User1", "CompanyA"}); });
+        ASSERT_FALSE(emplaced.empty());
+        ASSERT_EQ(emplaced, added);
+    }
+}
+
+// ExecuteMatches: Executing example 1 of the README streams fills worth its matching size between different companies
+TEST_F(OrderCacheTest, ExecuteMatches_ReadmeExample_FillsBetweenCompanies) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+    cache.addOrder(Order{"OrdId2", "SecId2", "Sell", 3000, "User2", "CompanyB"});
+    cache.addOrder(Order{"OrdId3", "SecId1", "Sell", 500, "User3", "CompanyA"});
+    cache.addOrder(Order{"OrdId4", "SecId2", "Buy", 600, "User4", "CompanyC"});
+    cache.addOrder(Order{"OrdId5", "SecId2", "Buy", 100, "User5", "CompanyB"});
+    cache.addOrder(Order{"OrdId6", "SecId3", "Buy", 1000, "User6", "CompanyD"});
+    cache.addOrder(Order{"OrdId7", "SecId2", "Buy", 2000, "User7", "CompanyE"});
+    cache.addOrder(Order{"OrdId8", "SecId2", "Sell", 5000, "User8", "CompanyE"});
+    std::map<std::string, std::string> companyOf;
+    for (const auto& order : cache.getAllOrders()) {
+        companyOf[order.orderId()] = order.company();
+    }
+
+    FillBuffer fills;
+    fills.reserve(16, 256);
+    ASSERT_EQ(cache.executeMatches("SecId1", fills), 0);
+    ASSERT_EQ(cache.executeMatches("SecId3", fills), 0);
+    ASSERT_EQ(cache.executeMatches("Unknown", fills), 0);
+    ASSERT_TRUE(fills.empty());
+    ASSERT_THROW(cache.executeMatches("", fills), std::invalid_argument);
+
+    ASSERT_EQ(cache.executeMatches("SecId2", fills), 2700);
+    unsigned int filledQty = 0;
+    for (std::size_t i = 0; i < fills.size(); i++) {
+        ASSERT_NE(companyOf[std::string(fills[i].buyOrderId)], companyOf[std::string(fills[i].sellOrderId)]);
+        filledQty += fills[i].qty;
+    }
+    ASSERT_EQ(filledQty, 2700);
+    ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId2"), 0);
+    ASSERT_EQ(cache.executeMatches("SecId2", fills), 0);
+
+    // the buys traded in full, the sells lost 2700 between them
+    unsigned int sellQty = 0;
+    for (const auto& order : cache.getAllOrders()) {
+        if (order.securityId() == "SecId2") {
+            ASSERT_TRUE(order.orderId() == "OrdId2" || order.orderId() == "OrdId8");
+            sellQty += order.qty();
+        }
+    }
+    ASSERT_EQ(sellQty, 8000 - 2700);
+    ASSERT_EQ(cache.getAllOrders().size(), 5);
+}
+
+// ExecuteMatches: On random books the executed qty equals the matching size and every order loses exactly its fills
+TEST_F(OrderCacheTest, ExecuteMatches_RandomBooks_ExecuteMatchingSize) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    const std::string path = "OrderCacheTest_execute_journal.bin";
+    std::remove(path.c_str());
+    OrderJournal journal(path);
+    cache.setJournal(&journal);
+
+    FillBuffer fills;
+    std::uniform_int_distribution<int> countDist(1, 60);
+    std::uniform_int_distribution<int> qtyDist(1, 20);
+    int nextId = 0;
+    for (int round = 0; round < 300; round++) {
+        // few companies, so one of them often dominates the book
+        std::string secId = "SecId" + std::to_string(round % 7);
+        int companyCount = 1 + round % 5;
+        int count = countDist(gen);
+        for (int i = 0; i < count; i++) {
+            cache.addOrder(Order{"OrdId" + std::to_string(nextId++), secId, sides[gen() % 2], qtyDist(gen) * 10u
+                , users[gen() % 20], companies[gen() % companyCount]});
+        }
+
+        std::map<std::string, Order> before;
+        for (const auto& order : cache.getAllOrders()) {
+            before.emplace(order.orderId(), order);
+        }
+        unsigned int matchingSize = cache.getMatchingSizeForSecurity(secId);
+        fills.clear();
+        ASSERT_EQ(cache.executeMatches(secId, fills), matchingSize);
+
+        std::map<std::string, unsigned int> filled;
+        unsigned int filledQty = 0;
+        for (std::size_t i = 0; i < fills.size(); i++) {
+            const Order& buy = before.at(std::string(fills[i].buyOrderId));
+            const Order& sell = before.at(std::string(fills[i].sellOrderId));
+            ASSERT_EQ(buy.securityId(), secId);
+            ASSERT_EQ(sell.securityId(), secId);
+            ASSERT_EQ(buy.side(), "Buy");
+            ASSERT_EQ(sell.side(), "Sell");
+            ASSERT_NE(buy.company(), sell.company());
+            ASSERT_GT(fills[i].qty, 0);
+            filled[buy.orderId()] += fills[i].qty;
+            filled[sell.orderId()] += fills[i].qty;
+            filledQty += fills[i].qty;
+        }
+        ASSERT_EQ(filledQty, matchingSize);
+        ASSERT_EQ(cache.getMatchingSizeForSecurity(secId), 0);
+
+        std::map<std::string, unsigned int> after;
+        for (const auto& order : cache.getAllOrders()) {
+            after[order.orderId()] = order.qty();
+        }
+        for (const auto& [orderId, order] : before) {
+            unsigned int left = order.qty() - filled[orderId];
+            ASSERT_LE(filled[orderId], order.qty());
+            ASSERT_EQ(after.count(orderId), left ? 1 : 0);
+            if (left) {
+                ASSERT_EQ(after[orderId], left);
+            }
+        }
+    }
+
+    // partly filled orders keep working with the min qty cancel
+    cache.cancelOrdersForSecIdWithMinimumQty("SecId0", 100);
+    for (const auto& order : cache.getAllOrders()) {
+        ASSERT_TRUE(order.securityId() != "SecId0" || order.qty() < 100);
+    }
+    journal.flush();
+    cache.setJournal(nullptr);
+
+    // replaying the adds and fills reaches the same open orders, not
+    // necessarily in the same book order
+    OrderCache replayed;
+    OrderJournal::replay(path, replayed);
+    std::map<std::string, unsigned int> expected, actual;
+    for (const auto& order : cache.getAllOrders()) {
+        expected[order.orderId()] = order.qty();
+    }
+    for (const auto& order : replayed.getAllOrders()) {
+        actual[order.orderId()] = order.qty();
+    }
+    ASSERT_EQ(actual, expected);
+    std::remove(path.c_str());
+}
+
+// ExecuteMatches: Executing into a reserved fill buffer allocates nothing once the cache has executed before
+TEST_F(OrderCacheTest, ExecuteMatches_ReservedBuffer_DoesNotAllocate) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    auto addOrders = [&](const std::string& prefix) {
+        for (int i = 0; i < 200; i++) {
+            cache.emplaceOrder(prefix + std::to_string(i), "SecId1", i % 2 ? "Sell" : "Buy", 100 + i % 7 * 10
+                , users[i % 10], companies[i % 4]);
+        }
+    };
+    addOrders("First");
+    FillBuffer fills;
+    fills.reserve(1000, 1000 * 2 * 16);
+    ASSERT_GT(cache.executeMatches("SecId1", fills), 0);
+    fills.clear();
+    // the same orders again rebuild the same book, which kept the capacity of
+    // its columns and qty buckets; they take the refs the first ones freed,
+    // whose list keeps its capacity too
+    for (int i = 0; i < 200; i++) {
+        cache.cancelOrder("First" + std::to_string(i));
+    }
+    addOrders("Second");
+
+    std::size_t before = heapAllocations.load();
+    ASSERT_GT(cache.executeMatches("SecId1", fills), 0);
+    ASSERT_EQ(heapAllocations.load(), before);
+    ASSERT_FALSE(fills.empty());
+}
+
+// Exposure: Open qty per company and security follows adds, cancels and executions
+TEST_F(OrderCacheTest, Exposure_CompanyQty_FollowsChanges) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+    cache.addOrder(Order{"OrdId2", "SecId1", "Sell", 300, "User2", "CompanyB"});
+    cache.addOrder(Order{"OrdId3", "SecId1", "Sell", 500, "User3", "CompanyA"});
+    cache.addOrder(Order{"OrdId4", "SecId2", "Buy", 600, "User1", "CompanyA"});
+
+    CompanyExposure exposure = cache.getCompanyExposure("SecId1", "CompanyA");
+    ASSERT_EQ(exposure.company, "CompanyA");
+    ASSERT_EQ(exposure.buyQty, 1000);
+    ASSERT_EQ(exposure.sellQty, 500);
+    exposure = cache.getCompanyExposure("CompanyA");
+    ASSERT_EQ(exposure.buyQty, 1600);
+    ASSERT_EQ(exposure.sellQty, 500);
+    exposure = cache.getCompanyExposure("SecId2", "CompanyB");
+    ASSERT_EQ(exposure.company, "CompanyB");
+    ASSERT_EQ(exposure.buyQty + exposure.sellQty, 0);
+    exposure = cache.getCompanyExposure("SecId1", "Unknown");
+    ASSERT_TRUE(exposure.company.empty());
+    ASSERT_EQ(exposure.buyQty + exposure.sellQty, 0);
+    ASSERT_EQ(cache.getCompanyExposure("Unknown").buyQty, 0);
+    ASSERT_TRUE(cache.getCompanyExposures("Unknown").empty());
+    ASSERT_THROW(cache.getCompanyExposure("", "CompanyA"), std::invalid_argument);
+    ASSERT_THROW(cache.getCompanyExposure(""), std::invalid_argument);
+    ASSERT_THROW(cache.getCompanyExposures(""), std::invalid_argument);
+
+    std::vector<CompanyExposure> exposures = cache.getCompanyExposures("SecId1");
+    std::sort(exposures.begin(), exposures.end(), [](const auto& a, const auto& b) { return a.company < b.company; });
+    ASSERT_EQ(exposures.size(), 2);
+    ASSERT_EQ(exposures[1].company, "CompanyB");
+    ASSERT_EQ(exposures[1].sellQty, 300);
+
+    // CompanyB's 300 sells trade against CompanyA's buy
+    FillBuffer fills;
+    ASSERT_EQ(cache.executeMatches("SecId1", fills), 300);
+    ASSERT_EQ(cache.getCompanyExposure("SecId1", "CompanyA").buyQty, 700);
+    ASSERT_EQ(cache.getCompanyExposures("SecId1").size(), 1);
+    cache.cancelOrder("OrdId3");
+    cache.cancelOrdersForUser("User1");
+    ASSERT_TRUE(cache.getCompanyExposures("SecId1").empty());
+    exposure = cache.getCompanyExposure("CompanyA");
+    ASSERT_EQ(exposure.buyQty + exposure.sellQty, 0);
+}
+
+// Exposure: After random changes the aggregates equal those summed from getAllOrders
+TEST_F(OrderCacheTest, Exposure_RandomChanges_MatchAggregatedOrders) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    std::vector<Order> orders = generateOrders(20000);
+    cache.addOrders(std::vector<Order>(orders.begin(), orders.begin() + 10000));
+    for (std::size_t i = 10000; i < orders.size(); i++) {
+        cache.addOrder(orders[i]);
+    }
+    for (std::size_t i = 0; i < orders.size(); i += 7) {
+        cache.cancelOrder(orders[i].orderId());
+    }
+    cache.cancelOrdersForUser(users[1]);
+    cache.cancelOrdersForSecIdWithMinimumQty(secIds[2], 1000);
+    FillBuffer fills;
+    for (std::size_t i = 0; i < NUM_SECURITIES; i += 3) {
+        cache.executeMatches(secIds[i], fills);
+    }
+
+    std::map<std::pair<std::string, std::string>, std::pair<unsigned long long, unsigned long long>> bySecurity;
+    std::map<std::string, std::pair<unsigned long long, unsigned long long>> byCompany;
+    for (const auto& order : cache.getAllOrders()) {
+        auto& qty = bySecurity[{order.securityId(), order.company()}];
+        auto& total = byCompany[order.company()];
+        (order.side() == "Buy" ? qty.first : qty.second) += order.qty();
+        (order.side() == "Buy" ? total.first : total.second) += order.qty();
+    }
+
+    for (const auto& company : companies) {
+        CompanyExposure exposure = cache.getCompanyExposure(company);
+        ASSERT_EQ(exposure.buyQty, byCompany[company].first);
+        ASSERT_EQ(exposure.sellQty, byCompany[company].second);
+    }
+    for (const auto& secId : secIds) {
+        std::size_t count = 0;
+        for (const auto& exposure : cache.getCompanyExposures(secId)) {
+            auto qty = bySecurity.at({secId, std::string(exposure.company)});
+            ASSERT_EQ(exposure.buyQty, qty.first);
+            ASSERT_EQ(exposure.sellQty, qty.second);
+            CompanyExposure point = cache.getCompanyExposure(secId, std::string(exposure.company));
+            ASSERT_EQ(point.buyQty, qty.first);
+            ASSERT_EQ(point.sellQty, qty.second);
+            count++;
+        }
+        ASSERT_EQ(count, static_cast<std::size_t>(std::count_if(bySecurity.begin(), bySecurity.end()
+            , [&](const auto& entry) { return entry.first.first == secId; })));
+    }
+}
+
+// Exposure: A loaded book answers from totals summed at load and a concurrent cache sums its shards, both as the cache
+TEST_F(OrderCacheTest, Exposure_LoadedBookAndConcurrentCache_MatchCache) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    const std::string path = "OrderCacheTest_exposure_book.bin";
+    std::vector<Order> orders = generateOrders(20000);
+    cache.addOrders(std::vector<Order>(orders.begin(), orders.end()));
+    for (std::size_t i = 0; i < orders.size(); i += 5) {
+        cache.cancelOrder(orders[i].orderId());
+    }
+    cache.saveBook(path);
+
+    OrderCache restored;
+    restored.loadBook(path);
+    ConcurrentOrderCache concurrent(8);
+    for (const auto& order : cache.getAllOrders()) {
+        concurrent.addOrder(order);
+    }
+
+    auto byCompany = [](std::vector<CompanyExposure> exposures) {
+        std::map<std::string, std::pair<unsigned long long, unsigned long long>> qty;
+        for (const auto& exposure : exposures) {
+            qty[std::string(exposure.company)] = { exposure.buyQty, exposure.sellQty };
+        }
+        return qty;
+    };
+    auto matchesCache = [&](auto& other) {
+        for (const auto& company : companies) {
+            CompanyExposure expected = cache.getCompanyExposure(company);
+            CompanyExposure actual = other.getCompanyExposure(company);
+            ASSERT_EQ(actual.company, expected.company);
+            ASSERT_EQ(actual.buyQty, expected.buyQty);
+            ASSERT_EQ(actual.sellQty, expected.sellQty);
+        }
+        for (std::size_t i = 0; i < NUM_SECURITIES; i += 10) {
+            ASSERT_EQ(byCompany(other.getCompanyExposures(secIds[i])), byCompany(cache.getCompanyExposures(secIds[i])));
+            CompanyExposure actual = other.getCompanyExposure(secIds[i], companies[i % companies.size()]);
+            CompanyExposure expected = cache.getCompanyExposure(secIds[i], companies[i % companies.size()]);
+            ASSERT_EQ(actual.buyQty, expected.buyQty);
+            ASSERT_EQ(actual.sellQty, expected.sellQty);
+        }
+        ASSERT_TRUE(other.getCompanyExposure("Unknown").company.empty());
+        ASSERT_TRUE(other.getCompanyExposure("Unknown", companies[0]).company.empty());
+        ASSERT_TRUE(other.getCompanyExposures("Unknown").empty());
+    };
+    matchesCache(restored);
+    ASSERT_TRUE(restored.isMapped());
+    matchesCache(concurrent);
+    ASSERT_THROW(concurrent.getCompanyExposure(""), std::invalid_argument);
+    ASSERT_THROW(concurrent.getCompanyExposures(""), std::invalid_argument);
+
+    // a name handed out while mapped stays valid once the state is built
+    std::string_view name = restored.getCompanyExposure(companies[0]).company;
+    restored.cancelOrder(orders[1].orderId());
+    ASSERT_FALSE(restored.isMapped());
+    ASSERT_EQ(name, companies[0]);
+
+    // the built state keeps its own totals, without those of the book
+    cache.cancelOrder(orders[1].orderId());
+    matchesCache(restored);
+    std::remove(path.c_str());
+}
+
+// Snapshot: A snapshot keeps the orders of the moment it was taken and shares unchanged books
+TEST_F(OrderCacheTest, Snapshot_PointInTime_KeepsOrdersAndSharesUnchangedBooks) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+    cache.addOrder(Order{"OrdId2", "SecId1", "Sell", 500, "User2", "CompanyB"});
+    cache.addOrder(Order{"OrdId3", "SecId2", "Sell", 300, "User1", "CompanyC"});
+
+    OrderSnapshot first = cache.snapshot();
+    std::vector<Order> before = cache.getAllOrders();
+    ASSERT_EQ(first.size(), 3);
+    ASSERT_GT(first.memoryBytes(), 0);
+    ASSERT_EQ(first.exclusiveBytes(), 0);
+
+    cache.cancelOrder("OrdId2");
+    cache.addOrder(Order{"OrdId4", "SecId1", "Buy", 700, "User3", "CompanyD"});
+    cache.cancelOrdersForUser("User1");
+
+    std::vector<Order> kept = first.getAllOrders();
+    ASSERT_EQ(kept.size(), before.size());
+    for (std::size_t i = 0; i < kept.size(); i++) {
+        ASSERT_EQ(kept[i].orderId(), before[i].orderId());
+        ASSERT_EQ(kept[i].securityId(), before[i].securityId());
+        ASSERT_EQ(kept[i].side(), before[i].side());
+        ASSERT_EQ(kept[i].qty(), before[i].qty());
+        ASSERT_EQ(kept[i].user(), before[i].user());
+        ASSERT_EQ(kept[i].company(), before[i].company());
+    }
+    // both books changed, so the first snapshot alone holds them now
+    ASSERT_EQ(first.exclusiveBytes(), first.memoryBytes());
+
+    OrderSnapshot second = cache.snapshot();
+    ASSERT_EQ(second.size(), 1);
+    cache.addOrder(Order{"OrdId5", "SecId3", "Buy", 100, "User4", "CompanyE"});
+    OrderSnapshot third = cache.snapshot();
+    ASSERT_EQ(third.size(), 2);
+    ASSERT_EQ(second.exclusiveBytes(), 0);
+    ASSERT_LT(third.exclusiveBytes(), third.memoryBytes());
+
+    // snapshots outlive a cleared cache, also in arena mode
+    OrderCache arenaCache{OrderCache::Arena{}};
+    arenaCache.addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+    OrderSnapshot arenaSnapshot = arenaCache.snapshot();
+    arenaCache.clear();
+    ASSERT_EQ(arenaSnapshot.getAllOrders()[0].orderId(), "OrdId1");
+    ASSERT_EQ(arenaSnapshot.exclusiveBytes(), arenaSnapshot.memoryBytes());
+}
+
+// Snapshot: Readers always see a consistent book while a writer keeps changing the sharded cache
+TEST_F(OrderCacheTest, Snapshot_ConcurrentWriter_ReadersSeeConsistentBooks) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    ConcurrentOrderCache concurrentCache(8);
+    constexpr int STEPS = 20000;
+    std::atomic<bool> writing{true};
+
+    // the writer adds order i and then cancels order i - 1, so any point in
+    // time holds one order or two consecutive ones
+    concurrentCache.addOrder(Order{"Ord0", "SecId1", "Buy", 100, "User1", "CompanyA"});
+    std::thread writer([&] {
+        for (int i = 1; i < STEPS; i++) {
+            concurrentCache.addOrder(Order{"Ord" + std::to_string(i), "SecId1", "Buy", 100, "User1", "CompanyA"});
+            concurrentCache.addOrder(Order{"Noise" + std::to_string(i), secIds[i % NUM_SECURITIES], "Sell", 100
+                , "User2", "CompanyB"});
+            concurrentCache.cancelOrder("Ord" + std::to_string(i - 1));
+        }
+        writing = false;
+    });
+
+    unsigned int snapshots = 0;
+    unsigned int inconsistent = 0;
+    while (writing || snapshots == 0) {
+        OrderSnapshot view = concurrentCache.snapshot();
+        std::vector<int> ids;
+        view.forEachOrder([&ids](const OrderView& order) {
+            if (order.orderId.substr(0, 3) == "Ord") {
+                ids.push_back(std::stoi(std::string(order.orderId.substr(3))));
+            }
+        });
+        std::sort(ids.begin(), ids.end());
+        if (!(ids.size() == 1 || (ids.size() == 2 && ids[1] == ids[0] + 1))) {
+            inconsistent++;
+        }
+        snapshots++;
+    }
+    writer.join();
+    ASSERT_EQ(inconsistent, 0);
+    std::cout << BLUE_COLOR << "[     INFO ] Snapshots checked: " << snapshots << RESET_COLOR << std::endl;
+}
+
+// Concurrency: The sharded cache gives the same results and errors as OrderCache
+TEST_F(OrderCacheTest, Concurrency_ConcurrentOrderCache_BehavesLikeOrderCache) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    ConcurrentOrderCache concurrentCache(8);
+    std::vector<Order> orders = generateOrders(20000);
+    for (const auto& order : orders) {
+        cache.addOrder(order);
+        concurrentCache.addOrder(order);
+    }
+
+    ASSERT_THROW(concurrentCache.addOrder(orders[10]), std::runtime_error);
+    ASSERT_THROW(concurrentCache.addOrder(Order{"NewId", "SecId1", "Hold", 100, "User1", "Comp1"}), std::invalid_argument);
+    ASSERT_THROW(concurrentCache.cancelOrder(""), std::invalid_argument);
+    ASSERT_THROW(concurrentCache.cancelOrdersForUser(""), std::invalid_argument);
+    ASSERT_THROW(concurrentCache.cancelOrdersForSecIdWithMinimumQty("", 100), std::invalid_argument);
+    ASSERT_THROW(concurrentCache.getMatchingSizeForSecurity(""), std::invalid_argument);
+
+    for (unsigned int i = 0; i < 20000; i += 7) {
+        cache.cancelOrder(orders[i].orderId());
+        concurrentCache.cancelOrder(orders[i].orderId());
+    }
+    for (unsigned int i = 0; i < 50; i++) {
+        cache.cancelOrdersForUser(users[i]);
+        concurrentCache.cancelOrdersForUser(users[i]);
+        cache.cancelOrdersForSecIdWithMinimumQty(secIds[i], 3000);
+        concurrentCache.cancelOrdersForSecIdWithMinimumQty(secIds[i], 3000);
+    }
+    for (const auto& secId : secIds) {
+        ASSERT_EQ(concurrentCache.getMatchingSizeForSecurity(secId), cache.getMatchingSizeForSecurity(secId));
+    }
+    ASSERT_EQ(concurrentCache.getAllOrders().size(), cache.getAllOrders().size());
+
+    // cancelled ids are free to be added again, live ones are still taken
+    concurrentCache.addOrder(orders[0]);
+    ASSERT_THROW(concurrentCache.addOrder(orders[1]), std::runtime_error);
+}
+
+// Concurrency: Writers racing on the same ids add each id once and leave the id index consistent
+TEST_F(OrderCacheTest, Concurrency_ConcurrentOrderCache_ParallelWritersKeepIdsUnique) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    ConcurrentOrderCache concurrentCache(16);
+    std::vector<Order> orders = generateOrders(20000);
+    constexpr unsigned int WRITERS = 4;
+    std::atomic<unsigned int> duplicates{0};
+    std::atomic<unsigned int> adding{WRITERS};
+
+    std::vector<std::thread> writers;
+    for (unsigned int w = 0; w < WRITERS; w++) {
+        writers.emplace_back([&, w] {
+            // every writer tries every order, then cancels its share of them
+            for (std::size_t i = 0; i < orders.size(); i++) {
+                const Order& order = orders[(i + w * 5000) % orders.size()];
+                try {
+                    concurrentCache.addOrder(order);
+                } catch (const std::runtime_error&) {
+                    duplicates++;
+                }
+            }
+            // no cancel may free an id another writer has yet to try
+            adding--;
+            while (adding.load() != 0) {
+                std::this_thread::yield();
+            }
+            for (std::size_t i = w; i < orders.size(); i += WRITERS * 2) {
+                concurrentCache.cancelOrder(orders[i].orderId());
+            }
+            concurrentCache.cancelOrdersForUser(users[w]);
+            concurrentCache.cancelOrdersForSecIdWithMinimumQty(secIds[w], 4000);
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    ASSERT_EQ(duplicates.load(), orders.size() * (WRITERS - 1));
+
+    std::vector<Order> remaining = concurrentCache.getAllOrders();
+    for (const auto& order : remaining) {
+        cache.addOrder(order);
+        ASSERT_THROW(concurrentCache.addOrder(order), std::runtime_error);
+    }
+    for (const auto& secId : secIds) {
+        ASSERT_EQ(concurrentCache.getMatchingSizeForSecurity(secId), cache.getMatchingSizeForSecurity(secId));
+    }
+    // every cancelled id can be added again
+    std::size_t readded = 0;
+    for (const auto& order : orders) {
+        try {
+            concurrentCache.addOrder(order);
+            readded++;
+        } catch (const std::runtime_error&) {
+        }
+    }
+    ASSERT_EQ(readded + remaining.size(), orders.size());
+}
+
+// Concurrency: A full ring rejects pushes until the consumer frees a cell and keeps FIFO order
+TEST_F(OrderCacheTest, Concurrency_MpscRing_FullRingRejectsPush) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    MpscRing<std::string> ring(3);
+    ASSERT_EQ(ring.capacity(), 4);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(ring.tryPush("Cmd" + std::to_string(i)));
+    }
+    std::string rejected = "Cmd4";
+    ASSERT_FALSE(ring.tryPush(std::move(rejected)));
+    ASSERT_EQ(rejected, "Cmd4");
+
+    std::string value;
+    ASSERT_TRUE(ring.tryPop(value));
+    ASSERT_EQ(value, "Cmd0");
+    ASSERT_TRUE(ring.tryPush(std::move(rejected)));
+    for (int i = 1; i <= 4; i++) {
+        ASSERT_TRUE(ring.tryPop(value));
+        ASSERT_EQ(value, "Cmd" + std::to_string(i));
+    }
+    ASSERT_FALSE(ring.tryPop(value));
+}
+
+// Concurrency: Values of every producer reach the consumer once and in the order they were pushed
+TEST_F(OrderCacheTest, Concurrency_MpscRing_ManyProducersKeepPerProducerOrder) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    constexpr unsigned int PRODUCERS = 4;
+    constexpr unsigned int PER_PRODUCER = 50000;
+    MpscRing<std::uint64_t> ring(64);
+
+    std::vector<std::thread> producers;
+    for (unsigned int p = 0; p < PRODUCERS; p++) {
+        producers.emplace_back([&ring, p] {
+            for (std::uint64_t i = 0; i < PER_PRODUCER; i++) {
+                while (!ring.tryPush((std::uint64_t(p) << 32) | i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    std::vector<std::uint64_t> next(PRODUCERS, 0);
+    for (unsigned int received = 0; received < PRODUCERS * PER_PRODUCER; ) {
+        std::uint64_t value;
+        if (!ring.tryPop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        unsigned int producer = static_cast<unsigned int>(value >> 32);
+        ASSERT_LT(producer, PRODUCERS);
+        ASSERT_EQ(value & 0xFFFFFFFFu, next[producer]++);
+        received++;
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+}
+
+// Concurrency: Commands from several threads are applied by the queue and report their result
+TEST_F(OrderCacheTest, Concurrency_OrderIngestQueue_AppliesCommandsAndReportsErrors) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    std::vector<Order> orders = generateOrders(20000);
+    constexpr unsigned int PRODUCERS = 4;
+    {
+        OrderIngestQueue queue(cache, 256, 64);
+        std::vector<std::thread> producers;
+        for (unsigned int p = 0; p < PRODUCERS; p++) {
+            producers.emplace_back([&, p] {
+                for (std::size_t i = p; i < orders.size(); i += PRODUCERS) {
+                    queue.addOrder(orders[i]);
+                    if (i % 3 == 0) {
+                        queue.cancelOrder(orders[i].orderId());
+                    }
+                }
+            });
+        }
+        for (auto& producer : producers) {
+            producer.join();
+        }
+
+        OrderIngestQueue::Completion duplicate, invalidSide, emptyCancel, cancel, added;
+        queue.addOrder(orders[1], &duplicate);
+        queue.addOrder(Order{"NewId", "SecId1", "Hold", 100, "User1", "Comp1"}, &invalidSide);
+        queue.cancelOrder("", &emptyCancel);
+        queue.cancelOrder(orders[2].orderId(), &cancel);
+        queue.addOrder(Order{"NewId", "SecId1", "Buy", 100, "User1", "Comp1"}, &added);
+        ASSERT_EQ(duplicate.wait(), OrderError::DuplicateOrderId);
+        ASSERT_EQ(invalidSide.wait(), OrderError::InvalidSide);
+        ASSERT_EQ(emptyCancel.wait(), OrderError::EmptyOrderId);
+        ASSERT_EQ(cancel.wait(), OrderError::None);
+        ASSERT_EQ(added.wait(), OrderError::None);
+
+        Order order = orders[0];
+        while (!queue.tryAddOrder(std::move(order))) {
+            ASSERT_EQ(order.orderId(), orders[0].orderId());
+        }
+        queue.flush();
+        // every third order and orders[2] are cancelled, orders[0] and NewId added again
+        std::size_t cancelled = (orders.size() + 2) / 3 + 1;
+        ASSERT_EQ(cache.getAllOrders().size(), orders.size() - cancelled + 2);
+    }
+
+    OrderCache reference;
+    for (std::size_t i = 0; i < orders.size(); i++) {
+        if (i % 3 != 0 && i != 2) {
+            reference.addOrder(orders[i]);
+        }
+    }
+    reference.addOrder(orders[0]);
+    reference.addOrder(Order{"NewId", "SecId1", "Buy", 100, "User1", "Comp1"});
+    for (const auto& secId : secIds) {
+        ASSERT_EQ(cache.getMatchingSizeForSecurity(secId), reference.getMatchingSizeForSecurity(secId));
+    }
+}
+
+// Concurrency: Threads waiting on commands queued behind a long backlog block and are woken when they complete
+TEST_F(OrderCacheTest, Concurrency_OrderIngestQueue_BlockedWaitersAreWoken) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    constexpr unsigned int WAITERS = 4;
+    std::vector<Order> orders = generateOrders(50000);
+    {
+        OrderIngestQueue queue(cache, 1 << 16, 64);
+        for (std::size_t i = WAITERS; i < orders.size(); i++) {
+            queue.addOrder(orders[i]);
+        }
+        std::vector<std::thread> waiters;
+        std::atomic<unsigned int> applied{0};
+        for (unsigned int w = 0; w < WAITERS; w++) {
+            waiters.emplace_back([&, w] {
+                OrderIngestQueue::Completion completion;
+                queue.addOrder(orders[w], &completion);
+                if (completion.wait() == OrderError::None) {
+                    applied++;
+                }
+            });
+        }
+        for (auto& waiter : waiters) {
+            waiter.join();
+        }
+        ASSERT_EQ(applied.load(), WAITERS);
+
+        // each flush waits on a completion on its stack, gone right after the wait
+        for (int i = 0; i < 1000; i++) {
+            queue.flush();
+        }
+    }
+    ASSERT_EQ(cache.getAllOrders().size(), orders.size());
+}
+
+// Concurrency: A command the cache throws on hands the exception to its completion and the applier keeps running
+TEST_F(OrderCacheTest, Concurrency_OrderIngestQueue_ExceptionReachesCompletion) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    OrderIngestQueue::Completion unpushed;
+    ASSERT_THROW(unpushed.wait(), std::logic_error);
+
+    FailingResource resource;
+    OrderCache failingCache(&resource);
+    {
+        OrderIngestQueue queue(failingCache, 256, 64);
+        OrderIngestQueue::Completion first;
+        queue.addOrder(Order{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"}, &first);
+        ASSERT_EQ(first.wait(), OrderError::None);
+
+        // a new security needs a book, which the resource refuses
+        resource.failing = true;
+        OrderIngestQueue::Completion failed;
+        queue.addOrder(Order{"OrdId2", "SecId2", "Sell", 500, "User2", "CompanyB"}, &failed);
+        ASSERT_THROW(failed.wait(), std::bad_alloc);
+        resource.failing = false;
+
+        OrderIngestQueue::Completion after;
+        queue.addOrder(Order{"OrdId3", "SecId1", "Sell", 400, "User3", "CompanyC"}, &after);
+        ASSERT_EQ(after.wait(), OrderError::None);
+        queue.flush();
+    }
+    ASSERT_EQ(failingCache.getMatchingSizeForSecurity("SecId1"), 400);
+    ASSERT_EQ(failingCache.getAllOrders().size(), 2);
+}
+
+// FilterKernels: The vector and scalar select kernels agree for every length and limit
+TEST_F(OrderCacheTest, FilterKernels_SelectLess_MatchesScalarKernel) {
+    CHECK_GLOBAL_FAILURE_FLAG();
+
+    std::uniform_int_distribution<unsigned int> qtyDist(0, 100);
+    for (unsigned int count = 0; count < 70; count++) {
+        std::vector<unsigned int> values(count);
+        for (auto& value : values) {
+            value = qtyDist(gen);
+        }
+        values.push_back(0xFFFFFFFFu);
+        for (unsigned int limit : {0u, 1u, 50u, 101u, 0x80000001u, 0xFFFFFFFFu}) {
+            std::vector<std::uint32_t> expected(values.size());
+            std::vector<std::uint32_t> vector(values.size());
+            std::vector<std::uint32_t> dispatched(values.size());
+            std::size_t kept = selectLessScalar(values.data(), values.size(), limit, expected.data());
+            ASSERT_EQ(selectLessAvx2(values.data(), values.size(), limit, vector.data()), kept);
+            ASSERT_EQ(selectLess(values.data(), values.size(), limit, dispatched.data()), kept);
+            for (std::size_t i = 0; i < kept; i++) {
+                ASSERT_LT(values[expected[i]], limit);
+                ASSERT_EQ(vector[i], expected[i]);
+                ASSERT_EQ(dispatched[i], expected[i]);
+            }
+        }
+    }
+}
+
 // Performance: Add and match 1,000 orders
 TEST_F(OrderCacheTest, Performance_SmallDataset_1KOrders) {
     CHECK_GLOBAL_FAILURE_FLAG();
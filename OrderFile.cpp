@@ -0,0 +1,87 @@
+#include <cstring>
+#include <limits>
+#include "OrderFile.h"
+
+static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// decimal qty without sign, false when it is not a number or overflows
+static bool parseQty(std::string_view text, unsigned int& qty)
+{
+  unsigned long long value = 0;
+  for(char c: text)
+  {
+    if(c < '0' || c > '9')
+      return false;
+    value = value * 10 + static_cast<unsigned int>(c - '0');
+    if(value > std::numeric_limits<unsigned int>::max())
+      return false;
+  }
+  qty = static_cast<unsigned int>(value);
+  return true;
+}
+
+static void parseLine(const char* pos, const char* end, OrderLine& line)
+{
+  static constexpr std::size_t FIELD_COUNT = 6;
+  std::string_view fields[FIELD_COUNT];
+  std::size_t count = 0;
+  while(true)
+  {
+    while(pos < end && isSpace(*pos))
+      pos++;
+    if(pos == end)
+      break;
+    if(count == FIELD_COUNT)
+    {
+      line.error = OrderError::MalformedLine;
+      return;
+    }
+    const char* field = pos;
+    while(pos < end && !isSpace(*pos))
+      pos++;
+    fields[count++] = std::string_view(field, static_cast<std::size_t>(pos - field));
+  }
+
+  if(count != FIELD_COUNT || !parseQty(fields[3], line.qty))
+  {
+    line.error = OrderError::MalformedLine;
+    return;
+  }
+  if(fields[2] == "Buy")
+    line.side = Side::Buy;
+  else if(fields[2] == "Sell")
+    line.side = Side::Sell;
+  else
+  {
+    line.error = OrderError::InvalidSide;
+    return;
+  }
+  line.orderId = fields[0];
+  line.securityId = fields[1];
+  line.user = fields[4];
+  line.company = fields[5];
+  line.error = OrderError::None;
+}
+
+std::size_t parseOrderLines(const char* begin, const char* end, std::vector<OrderLine>& lines)
+{
+  std::size_t index = 0;
+  for(const char* pos = begin; pos < end; index++)
+  {
+    const char* newline = static_cast<const char*>(std::memchr(pos, '\n', static_cast<std::size_t>(end - pos)));
+    const char* lineEnd = newline ? newline : end;
+
+    const char* first = pos;
+    while(first < lineEnd && isSpace(*first))
+      first++;
+    if(first < lineEnd)
+    {
+      lines.emplace_back();
+      OrderLine& line = lines.back();
+      line.line = index;
+      parseLine(first, lineEnd, line);
+    }
+    pos = newline ? newline + 1 : end;
+  }
+  return index;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+#include "OrderCache.h"
+
+// Text order files hold one order per line as whitespace-separated fields,
+// in the form used by the README:
+//
+//   OrdId1 SecId1 Buy 1000 User1 CompanyA
+//
+// Blank lines are skipped and a trailing '\r' is ignored. The parser works
+// on views of the file contents and allocates nothing per field.
+
+// one non-blank line; the views point into the parsed text
+struct OrderLine
+{
+  std::size_t line;  // zero-based, counted from the start of the parsed range
+  std::string_view orderId;
+  std::string_view securityId;
+  Side side;
+  unsigned int qty;
+  std::string_view user;
+  std::string_view company;
+  OrderError error;  // MalformedLine or InvalidSide, None if the fields parsed
+};
+
+// appends the non-blank lines of [begin, end) to lines and returns how many
+// lines the range holds, blank ones included
+std::size_t parseOrderLines(const char* begin, const char* end, std::vector<OrderLine>& lines);
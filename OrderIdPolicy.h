@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+// String of at most N chars held inline in whole 64-bit words, zero padded,
+// with the size in the last byte. Equality and hashing run over the words
+// with a count known at compile time, so they unroll into a few loads and
+// compares instead of a byte loop; the type is trivially copyable and can be
+// memcpy'd or written to a file as is.
+template<std::size_t N>
+class FixedString
+{
+  static_assert(N > 0 && N < 256, "FixedString holds 1 to 255 chars");
+
+ public:
+  static constexpr std::size_t WORDS = (N + 1 + 7) / 8;  // chars and the size byte
+
+  constexpr FixedString() = default;
+
+  // false, leaving the string unchanged, when value is longer than N
+  bool assign(std::string_view value)
+  {
+    if(value.size() > N)
+      return false;
+    for(auto& word: m_words)
+      word = 0;
+    std::memcpy(m_words, value.data(), value.size());
+    bytes()[sizeof(m_words) - 1] = static_cast<char>(value.size());
+    return true;
+  }
+
+  std::size_t size() const { return static_cast<unsigned char>(bytes()[sizeof(m_words) - 1]); }
+  bool empty() const       { return size() == 0; }
+  const char* data() const { return bytes(); }
+
+  operator std::string_view() const { return std::string_view(data(), size()); }
+
+  const std::uint64_t* words() const { return m_words; }
+
+  bool operator==(const FixedString& other) const
+  {
+    for(std::size_t i = 0; i < WORDS; i++)
+    {
+      if(m_words[i] != other.m_words[i])
+        return false;
+    }
+    return true;
+  }
+  bool operator!=(const FixedString& other) const { return !(*this == other); }
+
+ private:
+   char* bytes()             { return reinterpret_cast<char*>(m_words); }
+   const char* bytes() const { return reinterpret_cast<const char*>(m_words); }
+
+   std::uint64_t m_words[WORDS] = {};
+};
+
+namespace std
+{
+  template<std::size_t N>
+  struct hash<FixedString<N>>
+  {
+    std::size_t operator()(const FixedString<N>& value) const
+    {
+      // multiply-xorshift per word, then the MurmurHash3 finalizer so the
+      // low bits the hash maps probe by depend on every char
+      std::uint64_t hash = 0;
+      for(std::size_t i = 0; i < FixedString<N>::WORDS; i++)
+      {
+        hash = (hash ^ value.words()[i]) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 32;
+      }
+      hash ^= hash >> 33;
+      hash *= 0xff51afd7ed558ccdULL;
+      hash ^= hash >> 33;
+      hash *= 0xc4ceb9fe1a85ec53ULL;
+      hash ^= hash >> 33;
+      return static_cast<std::size_t>(hash);
+    }
+  };
+}
+
+// Order id policies: how BasicOrderCache stores the id of a resting order
+// and keys its order index by it.
+//
+// StringOrderIds keeps ids of any length in strings allocated from the
+// cache's memory resource and keys the index by views of them.
+struct StringOrderIds
+{
+  using Storage = std::pmr::string;
+  using Key = std::string_view;
+  static constexpr std::size_t MAX_SIZE = std::string_view::npos;
+
+  static Storage make(std::pmr::memory_resource* resource) { return Storage(resource); }
+  static bool assign(Storage& storage, std::string_view orderId) { storage.assign(orderId); return true; }
+  static Key key(const Storage& storage) { return storage; }
+
+  // false when no stored id can equal orderId
+  static bool toKey(std::string_view orderId, Key& key) { key = orderId; return true; }
+};
+
+// FixedOrderIds keeps ids of up to N chars in FixedString<N>, which is both
+// the storage and the key: the index slots hold the ids themselves and a
+// lookup compares words without following a pointer.
+template<std::size_t N>
+struct FixedOrderIds
+{
+  using Storage = FixedString<N>;
+  using Key = FixedString<N>;
+  static constexpr std::size_t MAX_SIZE = N;
+
+  static Storage make(std::pmr::memory_resource*) { return Storage(); }
+  static bool assign(Storage& storage, std::string_view orderId) { return storage.assign(orderId); }
+  static const Key& key(const Storage& storage) { return storage; }
+
+  static bool toKey(std::string_view orderId, Key& key) { return key.assign(orderId); }
+};
@@ -0,0 +1,224 @@
+#include <chrono>
+#include <stdexcept>
+#include "OrderIngestQueue.h"
+
+// empty polls the applier spins through before it starts sleeping
+static constexpr unsigned int IDLE_SPINS = 128;
+static constexpr std::chrono::microseconds IDLE_SLEEP(50);
+
+// polls of a completion before its waiter blocks
+static constexpr unsigned int WAIT_SPINS = 128;
+
+OrderError OrderIngestQueue::Completion::wait() const
+{
+  if(!m_queue)
+    throw std::logic_error("Error: completion was never pushed!");
+
+  bool applied = false;
+  for(unsigned int spin = 0; spin < WAIT_SPINS && !applied; spin++)
+  {
+    applied = done.load(std::memory_order_acquire);
+    if(!applied)
+      std::this_thread::yield();
+  }
+
+  if(!applied)
+  {
+    // the waiter count is raised before done is checked and the applier sets
+    // done before it reads the count, so one of them sees the other
+    OrderIngestQueue& queue = *m_queue;
+    std::unique_lock<std::mutex> lock(queue.m_waitMutex);
+    queue.m_waiters.fetch_add(1);
+    queue.m_completed.wait(lock, [this] { return done.load(); });
+    queue.m_waiters.fetch_sub(1);
+  }
+  if(exception)
+    std::rethrow_exception(exception);
+  return error;
+}
+
+OrderIngestQueue::OrderIngestQueue(OrderCache& cache, std::size_t capacity, std::size_t batchSize)
+    : m_cache(cache),
+      m_ring(capacity),
+      m_batchSize(batchSize ? batchSize : 1),
+      m_applier(&OrderIngestQueue::applyLoop, this) { }
+
+OrderIngestQueue::~OrderIngestQueue()
+{
+  m_stop.store(true, std::memory_order_release);
+  m_applier.join();
+}
+
+bool OrderIngestQueue::tryAddOrder(Order&& order, Completion* completion)
+{
+  Command command = makeCommand(Command::Kind::Add, completion);
+  command.order = std::move(order);
+  if(m_ring.tryPush(std::move(command)))
+    return true;
+  order = std::move(command.order);
+  return false;
+}
+
+bool OrderIngestQueue::tryCancelOrder(const std::string& orderId, Completion* completion)
+{
+  Command command = makeCommand(Command::Kind::Cancel, completion);
+  command.orderId = orderId;
+  return m_ring.tryPush(std::move(command));
+}
+
+void OrderIngestQueue::addOrder(Order order, Completion* completion)
+{
+  Command command = makeCommand(Command::Kind::Add, completion);
+  command.order = std::move(order);
+  push(command);
+}
+
+void OrderIngestQueue::cancelOrder(const std::string& orderId, Completion* completion)
+{
+  Command command = makeCommand(Command::Kind::Cancel, completion);
+  command.orderId = orderId;
+  push(command);
+}
+
+void OrderIngestQueue::flush()
+{
+  Completion completion;
+  Command command = makeCommand(Command::Kind::Sync, &completion);
+  push(command);
+  completion.wait();
+}
+
+////------------------------  PRIVATE -------------------------------------------
+
+OrderIngestQueue::Command OrderIngestQueue::makeCommand(Command::Kind kind, Completion* completion)
+{
+  Command command;
+  command.kind = kind;
+  command.completion = completion;
+  if(completion)
+    completion->m_queue = this;
+  return command;
+}
+
+void OrderIngestQueue::push(Command& command)
+{
+  while(!m_ring.tryPush(std::move(command)))
+    std::this_thread::yield();
+}
+
+void OrderIngestQueue::applyLoop()
+{
+  m_batch.reserve(m_batchSize);
+  m_adds.reserve(m_batchSize);
+  m_addCompletions.reserve(m_batchSize);
+  Command command;
+  unsigned int idle = 0;
+  while(true)
+  {
+    // the stop flag is read before polling, so an empty poll after the stop
+    // means every command pushed before the destructor ran is applied
+    bool stopping = m_stop.load(std::memory_order_acquire);
+    while(m_batch.size() < m_batchSize && m_ring.tryPop(command))
+      m_batch.push_back(std::move(command));
+
+    if(!m_batch.empty())
+    {
+      apply();
+      m_batch.clear();
+      idle = 0;
+      continue;
+    }
+    if(stopping)
+      return;
+
+    if(++idle < IDLE_SPINS)
+      std::this_thread::yield();
+    else
+      std::this_thread::sleep_for(IDLE_SLEEP);
+  }
+}
+
+void OrderIngestQueue::apply()
+{
+  // commands apply in ring order, a cancel ends the run of adds before it
+  for(Command& command: m_batch)
+  {
+    switch(command.kind)
+    {
+      case Command::Kind::Add:
+        m_adds.push_back(std::move(command.order));
+        m_addCompletions.push_back(command.completion);
+        break;
+      case Command::Kind::Cancel:
+        applyAdds();
+        if(command.orderId.empty())
+        {
+          complete(command.completion, OrderError::EmptyOrderId);
+          break;
+        }
+        try
+        {
+          m_cache.cancelOrder(command.orderId);
+        }
+        catch(...)
+        {
+          complete(command.completion, OrderError::None, std::current_exception());
+          break;
+        }
+        complete(command.completion, OrderError::None);
+        break;
+      case Command::Kind::Sync:
+        applyAdds();
+        complete(command.completion, OrderError::None);
+        break;
+    }
+  }
+  applyAdds();
+}
+
+void OrderIngestQueue::applyAdds()
+{
+  if(m_adds.empty())
+    return;
+
+  // addOrders() reads the orders in place, so the buffer keeps its capacity;
+  // if it throws, every add of the run gets the exception
+  std::vector<BatchError> errors;
+  try
+  {
+    errors = m_cache.addOrders(std::move(m_adds));
+  }
+  catch(...)
+  {
+    std::exception_ptr exception = std::current_exception();
+    for(Completion* completion: m_addCompletions)
+      complete(completion, OrderError::None, exception);
+    m_adds.clear();
+    m_addCompletions.clear();
+    return;
+  }
+  auto error = errors.begin();
+  for(std::size_t i = 0; i < m_addCompletions.size(); i++)
+  {
+    OrderError result = OrderError::None;
+    if(error != errors.end() && error->index == i)
+      result = (error++)->error;
+    complete(m_addCompletions[i], result);
+  }
+  m_adds.clear();
+  m_addCompletions.clear();
+}
+
+void OrderIngestQueue::complete(Completion* completion, OrderError error, std::exception_ptr exception)
+{
+  if(!completion)
+    return;
+  completion->error = error;
+  completion->exception = std::move(exception);
+  completion->done.store(true);
+  if(m_waiters.load())
+  {
+    std::lock_guard<std::mutex> lock(m_waitMutex);
+    m_completed.notify_all();
+  }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MpscRing.h"
+#include "OrderCache.h"
+
+// Front end feeding an OrderCache from many threads without locks. Callers
+// push add and cancel commands into a bounded MPSC ring and a single applier
+// thread drains it in batches into the cache, runs of adds going through
+// addOrders(). A command the cache throws on hands the exception to its
+// completion and the applier carries on with the next one. The cache must not be used directly while the queue runs,
+// except after flush() with no command in flight.
+class OrderIngestQueue
+{
+ public:
+  // result of one command, owned by the caller and filled in by the applier;
+  // it must outlive the command
+  struct Completion
+  {
+    std::atomic<bool> done{false};
+    OrderError error = OrderError::None;
+    std::exception_ptr exception;  // thrown by the cache applying the command
+
+    // waits until the command is applied and returns its result, rethrowing
+    // what the cache threw; spins for a while, then blocks until the applier
+    // signals. Throws std::logic_error if the completion was never pushed
+    OrderError wait() const;
+
+   private:
+    friend class OrderIngestQueue;
+    OrderIngestQueue* m_queue = nullptr;  // set when the command is pushed
+  };
+
+  explicit OrderIngestQueue(OrderCache& cache, std::size_t capacity = 1 << 16, std::size_t batchSize = 256);
+
+  // applies the commands still queued, then stops the applier
+  ~OrderIngestQueue();
+
+  OrderIngestQueue(const OrderIngestQueue&) = delete;
+  OrderIngestQueue& operator=(const OrderIngestQueue&) = delete;
+
+  // false when the ring is full, the order is then left untouched
+  bool tryAddOrder(Order&& order, Completion* completion = nullptr);
+  bool tryCancelOrder(const std::string& orderId, Completion* completion = nullptr);
+
+  // retry until the ring has room
+  void addOrder(Order order, Completion* completion = nullptr);
+  void cancelOrder(const std::string& orderId, Completion* completion = nullptr);
+
+  // waits until every command pushed before the call is applied
+  void flush();
+
+  std::size_t capacity() const { return m_ring.capacity(); }
+
+ private:
+   struct Command
+   {
+     enum class Kind : unsigned char { Add, Cancel, Sync };
+
+     Kind kind = Kind::Sync;
+     Order order{ std::string(), std::string(), std::string(), 0, std::string(), std::string() };
+     std::string orderId;
+     Completion* completion = nullptr;
+   };
+
+   OrderCache& m_cache;
+   MpscRing<Command> m_ring;
+   std::size_t m_batchSize;
+   std::atomic<bool> m_stop{false};
+
+   // completions blocked in wait() sleep here; the applier only takes the
+   // lock when someone sleeps, and never touches a completion after setting
+   // its done flag, so the caller may destroy it as soon as it sees the flag
+   std::mutex m_waitMutex;
+   std::condition_variable m_completed;
+   std::atomic<unsigned int> m_waiters{0};
+
+   // used by the applier thread only, reused from batch to batch
+   std::vector<Command> m_batch;
+   std::vector<Order> m_adds;
+   std::vector<Completion*> m_addCompletions;
+
+   std::thread m_applier;
+
+   Command makeCommand(Command::Kind kind, Completion* completion);
+   void push(Command& command);
+
+   void applyLoop();
+   void apply();
+   void applyAdds();
+
+   void complete(Completion* completion, OrderError error, std::exception_ptr exception = nullptr);
+};
@@ -0,0 +1,322 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include "OrderJournal.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ORDER_JOURNAL_SYNC 1
+#include <unistd.h>
+#endif
+
+// version 2 records fills where version 1 re-ran executeMatches()
+static constexpr char JOURNAL_MAGIC[8] = { 'O', 'C', 'J', 'R', 'N', 'L', '\0', '\2' };
+
+static void putVarint(std::vector<char>& out, std::uint64_t value)
+{
+  while(value >= 0x80)
+  {
+    out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+static void putString(std::vector<char>& out, std::string_view value)
+{
+  putVarint(out, value.size());
+  out.insert(out.end(), value.begin(), value.end());
+}
+
+// false when the varint runs past end
+static bool getVarint(const char*& pos, const char* end, std::uint64_t& value)
+{
+  value = 0;
+  for(unsigned int shift = 0; pos < end && shift < 64; shift += 7)
+  {
+    unsigned char byte = static_cast<unsigned char>(*pos++);
+    value |= std::uint64_t(byte & 0x7F) << shift;
+    if(!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+static bool getString(const char*& pos, const char* end, std::string_view& value)
+{
+  std::uint64_t size;
+  if(!getVarint(pos, end, size) || size > static_cast<std::uint64_t>(end - pos))
+    return false;
+  value = std::string_view(pos, size);
+  pos += size;
+  return true;
+}
+
+static std::vector<char> readFile(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if(!file)
+    return {};
+  std::vector<char> data(static_cast<std::size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(data.data(), static_cast<std::streamsize>(data.size()));
+  return data;
+}
+
+static bool hasMagic(const std::vector<char>& data)
+{
+  return data.size() >= sizeof(JOURNAL_MAGIC) && std::memcmp(data.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0;
+}
+
+OrderJournal::OrderJournal(const std::string& path, bool sync)
+    : m_sync(sync)
+{
+  // drops a record cut short by a crash, later records would be unreadable
+  std::vector<char> existing = readFile(path);
+  if(!existing.empty())
+  {
+    if(!hasMagic(existing))
+      throw std::runtime_error("Error: invalid journal file!");
+    std::size_t end = sizeof(JOURNAL_MAGIC) + scan(existing.data() + sizeof(JOURNAL_MAGIC)
+      , existing.size() - sizeof(JOURNAL_MAGIC), [](Op, const char*, const char*) { });
+    if(end < existing.size())
+      std::filesystem::resize_file(path, end);
+  }
+
+  m_file = std::fopen(path.c_str(), "ab");
+  if(!m_file)
+    throw std::runtime_error("Error: cannot open journal file!");
+  if(existing.empty())
+    m_buffer.assign(JOURNAL_MAGIC, JOURNAL_MAGIC + sizeof(JOURNAL_MAGIC));
+  m_appended = m_buffer.size();
+  m_writer = std::thread(&OrderJournal::writerLoop, this);
+}
+
+OrderJournal::~OrderJournal()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_one();
+  m_writer.join();
+  std::fclose(m_file);
+}
+
+std::uint64_t OrderJournal::recordAdd(std::string_view orderId, std::string_view securityId, Side side
+  , unsigned int qty, std::string_view user, std::string_view company)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_record.clear();
+  m_record.push_back(static_cast<char>(side == Side::Buy ? Op::AddBuy : Op::AddSell));
+  putString(m_record, orderId);
+  putString(m_record, securityId);
+  putVarint(m_record, qty);
+  putString(m_record, user);
+  putString(m_record, company);
+  return append();
+}
+
+std::uint64_t OrderJournal::recordCancel(std::string_view orderId)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_record.clear();
+  m_record.push_back(static_cast<char>(Op::Cancel));
+  putString(m_record, orderId);
+  return append();
+}
+
+std::uint64_t OrderJournal::recordCancelForUser(std::string_view user)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_record.clear();
+  m_record.push_back(static_cast<char>(Op::CancelForUser));
+  putString(m_record, user);
+  return append();
+}
+
+std::uint64_t OrderJournal::recordCancelForSecIdWithMinimumQty(std::string_view securityId, unsigned int minQty)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_record.clear();
+  m_record.push_back(static_cast<char>(Op::CancelForSecIdWithMinimumQty));
+  putString(m_record, securityId);
+  putVarint(m_record, minQty);
+  return append();
+}
+
+std::uint64_t OrderJournal::recordFill(std::string_view buyOrderId, std::string_view sellOrderId, unsigned int qty)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_record.clear();
+  m_record.push_back(static_cast<char>(Op::Fill));
+  putString(m_record, buyOrderId);
+  putString(m_record, sellOrderId);
+  putVarint(m_record, qty);
+  return append();
+}
+
+std::uint64_t OrderJournal::recordClear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_record.clear();
+  m_record.push_back(static_cast<char>(Op::Clear));
+  return append();
+}
+
+std::uint64_t OrderJournal::recordLoadBook(std::string_view path)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_record.clear();
+  m_record.push_back(static_cast<char>(Op::LoadBook));
+  putString(m_record, path);
+  return append();
+}
+
+void OrderJournal::waitDurable(std::uint64_t position)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_written.wait(lock, [&] { return m_durable >= position || m_failed; });
+  if(m_durable < position)
+    throw std::runtime_error("Error: cannot write journal file!");
+}
+
+void OrderJournal::flush()
+{
+  std::uint64_t position;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    position = m_appended;
+  }
+  waitDurable(position);
+}
+
+std::size_t OrderJournal::replay(const std::string& path, OrderCache& cache)
+{
+  std::vector<char> data = readFile(path);
+  if(data.empty())
+    return 0;
+  if(!hasMagic(data))
+    throw std::runtime_error("Error: invalid journal file!");
+
+  std::size_t count = 0;
+  std::string text;
+  scan(data.data() + sizeof(JOURNAL_MAGIC), data.size() - sizeof(JOURNAL_MAGIC)
+    , [&](Op op, const char* pos, const char* end)
+  {
+    std::string_view orderId, securityId, user, company, sellOrderId, path;
+    std::uint64_t qty;
+    switch(op)
+    {
+      case Op::AddBuy:
+      case Op::AddSell:
+        if(getString(pos, end, orderId) && getString(pos, end, securityId) && getVarint(pos, end, qty)
+          && getString(pos, end, user) && getString(pos, end, company))
+        {
+          cache.addOrderFields(orderId, securityId, op == Op::AddBuy ? Side::Buy : Side::Sell
+            , static_cast<unsigned int>(qty), user, company);
+        }
+        break;
+      case Op::Cancel:
+        if(getString(pos, end, orderId))
+          cache.cancelOrderId(orderId);
+        break;
+      case Op::CancelForUser:
+        if(getString(pos, end, user) && !user.empty())
+          cache.cancelOrdersForUser(text.assign(user));
+        break;
+      case Op::CancelForSecIdWithMinimumQty:
+        if(getString(pos, end, securityId) && getVarint(pos, end, qty) && !securityId.empty() && qty)
+          cache.cancelOrdersForSecIdWithMinimumQty(text.assign(securityId), static_cast<unsigned int>(qty));
+        break;
+      case Op::Fill:
+        if(getString(pos, end, orderId) && getString(pos, end, sellOrderId) && getVarint(pos, end, qty) && qty)
+          cache.applyFill(orderId, sellOrderId, static_cast<unsigned int>(qty));
+        break;
+      case Op::Clear:
+        cache.clear();
+        break;
+      case Op::LoadBook:
+        if(getString(pos, end, path))
+          cache.loadBook(text.assign(path));
+        break;
+    }
+    count++;
+  });
+  return count;
+}
+
+////------------------------  PRIVATE -------------------------------------------
+
+std::uint64_t OrderJournal::append()
+{
+  if(m_failed)
+    throw std::runtime_error("Error: cannot write journal file!");
+  std::size_t before = m_buffer.size();
+  putVarint(m_buffer, m_record.size());
+  m_buffer.insert(m_buffer.end(), m_record.begin(), m_record.end());
+  m_appended += m_buffer.size() - before;
+  // the writer only sleeps while the buffer is empty
+  if(!before)
+    m_wake.notify_one();
+  return m_appended;
+}
+
+void OrderJournal::writerLoop()
+{
+  std::vector<char> pending;
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while(true)
+  {
+    m_wake.wait(lock, [this] { return m_stop || !m_buffer.empty(); });
+    if(m_buffer.empty())
+      return;
+
+    // takes everything appended so far and writes it outside the lock
+    pending.swap(m_buffer);
+    std::uint64_t position = m_appended;
+    lock.unlock();
+
+    bool written = std::fwrite(pending.data(), 1, pending.size(), m_file) == pending.size()
+      && std::fflush(m_file) == 0;
+#ifdef ORDER_JOURNAL_SYNC
+#ifdef __linux__
+    if(written && m_sync)
+      written = ::fdatasync(fileno(m_file)) == 0;
+#else
+    if(written && m_sync)
+      written = ::fsync(fileno(m_file)) == 0;
+#endif
+#endif
+    pending.clear();
+
+    lock.lock();
+    if(!written)
+    {
+      // later records would follow a gap, so nothing more is written
+      m_failed = true;
+      m_buffer.clear();
+      m_written.notify_all();
+      return;
+    }
+    m_durable = position;
+    m_written.notify_all();
+  }
+}
+
+template<typename Apply>
+std::size_t OrderJournal::scan(const char* data, std::size_t size, Apply&& apply)
+{
+  const char* pos = data;
+  const char* end = data + size;
+  while(pos < end)
+  {
+    const char* record = pos;
+    std::uint64_t length;
+    if(!getVarint(record, end, length) || !length || length > static_cast<std::uint64_t>(end - record))
+      break;
+    apply(static_cast<Op>(*record), record + 1, record + length);
+    pos = record + length;
+  }
+  return static_cast<std::size_t>(pos - data);
+}
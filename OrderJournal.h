@@ -0,0 +1,107 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "OrderCache.h"
+
+// Append-only journal of the changes made to an OrderCache. Calls on the
+// cache only encode the change into an in-memory buffer; a background
+// thread takes everything buffered so far and writes it with one write and
+// one fdatasync (group commit), so the cost of a sync is shared by all the
+// changes that arrived while the previous one ran.
+//
+// The cache records a change before applying it, but returns before the
+// record is on disk: a crash loses the changes after the last flush() or
+// waitDurable(), even those whose calls already returned. Once a write or
+// sync fails the journal writes nothing more, so the file never has a gap
+// followed by later records, and every further change is rejected.
+//
+// The file starts with an 8-byte magic and version, then holds records of
+// a varint body length and a body: an op byte followed by varint lengths
+// and bytes of its strings and varint numbers. A record cut short by a
+// crash is dropped when the journal is opened or replayed.
+//
+// executeMatches() is journaled as its fills, one record per fill, so that
+// a replay reduces the same orders by the same qty instead of matching again
+// on a book that may be laid out differently. A journal started on a cache
+// that already held orders, e.g. one restored from a book file, replays onto
+// a cache restored the same way. clear() and loadBook() are journaled too;
+// a replayed loadBook() reads the book file again from its path.
+class OrderJournal
+{
+ public:
+  // opens or creates the journal for appending, throws std::runtime_error
+  // if it cannot be opened or is not a journal; sync = false skips the
+  // fdatasync and leaves durability to the OS
+  explicit OrderJournal(const std::string& path, bool sync = true);
+
+  // writes what is still buffered
+  ~OrderJournal();
+
+  OrderJournal(const OrderJournal&) = delete;
+  OrderJournal& operator=(const OrderJournal&) = delete;
+
+  // append a change and return its position, to be passed to waitDurable();
+  // throw std::runtime_error once the journal could not be written
+  std::uint64_t recordAdd(std::string_view orderId, std::string_view securityId, Side side, unsigned int qty
+    , std::string_view user, std::string_view company);
+  std::uint64_t recordCancel(std::string_view orderId);
+  std::uint64_t recordCancelForUser(std::string_view user);
+  std::uint64_t recordCancelForSecIdWithMinimumQty(std::string_view securityId, unsigned int minQty);
+  std::uint64_t recordFill(std::string_view buyOrderId, std::string_view sellOrderId, unsigned int qty);
+  std::uint64_t recordClear();
+  std::uint64_t recordLoadBook(std::string_view path);
+
+  // waits until every change up to position is on disk, throws
+  // std::runtime_error if the journal could not be written
+  void waitDurable(std::uint64_t position);
+
+  // waits until every change recorded so far is on disk
+  void flush();
+
+  // applies the changes in the journal at path to cache and returns how many
+  // were read; throws std::runtime_error if the file is not a journal
+  static std::size_t replay(const std::string& path, OrderCache& cache);
+
+ private:
+   enum class Op : unsigned char
+   {
+     AddBuy = 1,
+     AddSell,
+     Cancel,
+     CancelForUser,
+     CancelForSecIdWithMinimumQty,
+     Fill,
+     Clear,
+     LoadBook
+   };
+
+   std::FILE* m_file = nullptr;
+   bool m_sync;
+
+   std::mutex m_mutex;
+   std::condition_variable m_wake;     // signals the writer
+   std::condition_variable m_written;  // signals waitDurable()
+   std::vector<char> m_buffer;         // encoded, not yet taken by the writer
+   std::vector<char> m_record;         // scratch for the record being encoded
+   std::uint64_t m_appended = 0;       // end of the last record appended
+   std::uint64_t m_durable = 0;        // end of the last record on disk
+   bool m_failed = false;
+   bool m_stop = false;
+   std::thread m_writer;
+
+   std::uint64_t append();
+   void writerLoop();
+
+   // calls apply(op, body, size) for each whole record and returns the end of
+   // the last one
+   template<typename Apply>
+   static std::size_t scan(const char* data, std::size_t size, Apply&& apply);
+};
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include "WorkStealingPool.h"
+
+WorkStealingPool::WorkStealingPool(unsigned int threads)
+{
+  if(!threads)
+    threads = 1;
+  for(unsigned int i = 0; i < threads; i++)
+    m_queues.push_back(std::make_unique<Queue>());
+  for(unsigned int i = 1; i < threads; i++)
+    m_workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_wakeMutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for(auto& worker: m_workers)
+    worker.join();
+}
+
+void WorkStealingPool::parallelFor(std::size_t count, std::size_t grain
+  , const std::function<void(std::size_t, std::size_t)>& task)
+{
+  if(!count)
+    return;
+  if(!grain)
+    grain = 1;
+
+  std::lock_guard<std::mutex> loop(m_loopMutex);
+  std::size_t chunks = (count + grain - 1) / grain;
+  if(chunks == 1 || m_workers.empty())
+  {
+    task(0, count);
+    return;
+  }
+
+  // each queue gets a contiguous block of ranges, stealing evens out the rest
+  m_task = &task;
+  m_remaining.store(chunks, std::memory_order_relaxed);
+  std::size_t queues = m_queues.size();
+  for(std::size_t q = 0; q < queues; q++)
+  {
+    std::lock_guard<std::mutex> lock(m_queues[q]->mutex);
+    for(std::size_t chunk = q * chunks / queues; chunk < (q + 1) * chunks / queues; chunk++)
+      m_queues[q]->ranges.push_back(Range{ chunk * grain, std::min(count, (chunk + 1) * grain) });
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_wakeMutex);
+    m_generation++;
+  }
+  m_wake.notify_all();
+
+  runRanges(0);
+
+  std::unique_lock<std::mutex> lock(m_wakeMutex);
+  m_done.wait(lock, [this] { return m_remaining.load(std::memory_order_acquire) == 0; });
+  m_task = nullptr;
+}
+
+////------------------------  PRIVATE -------------------------------------------
+
+void WorkStealingPool::workerLoop(unsigned int self)
+{
+  unsigned long long seen = 0;
+  while(true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(m_wakeMutex);
+      m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+      if(m_stop)
+        return;
+      seen = m_generation;
+    }
+    runRanges(self);
+  }
+}
+
+void WorkStealingPool::runRanges(unsigned int self)
+{
+  Range range;
+  while(pop(self, range) || steal(self, range))
+  {
+    // a range is only queued while its loop runs, so m_task is still valid
+    (*m_task)(range.begin, range.end);
+    if(m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      std::lock_guard<std::mutex> lock(m_wakeMutex);
+      m_done.notify_one();
+    }
+  }
+}
+
+bool WorkStealingPool::pop(unsigned int self, Range& range)
+{
+  Queue& queue = *m_queues[self];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if(queue.ranges.empty())
+    return false;
+  range = queue.ranges.back();
+  queue.ranges.pop_back();
+  return true;
+}
+
+bool WorkStealingPool::steal(unsigned int self, Range& range)
+{
+  std::size_t queues = m_queues.size();
+  for(std::size_t i = 1; i < queues; i++)
+  {
+    Queue& victim = *m_queues[(self + i) % queues];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if(!victim.ranges.empty())
+    {
+      range = victim.ranges.front();
+      victim.ranges.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
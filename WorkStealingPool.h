@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running index ranges of a loop. Every participant
+// owns a queue of ranges: it pops its own ranges from the back and, once its
+// queue is empty, steals from the front of the others, so threads that drew
+// cheap ranges take over the work of threads that drew expensive ones.
+class WorkStealingPool
+{
+ public:
+  // threads counts the calling thread, which takes part in every loop
+  explicit WorkStealingPool(unsigned int threads = std::thread::hardware_concurrency());
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  unsigned int size() const { return static_cast<unsigned int>(m_queues.size()); }
+
+  // calls task(begin, end) for ranges of at most grain indexes covering
+  // [0, count) and returns once all of them are done; one loop runs at a time
+  void parallelFor(std::size_t count, std::size_t grain
+    , const std::function<void(std::size_t, std::size_t)>& task);
+
+ private:
+   struct Range
+   {
+     std::size_t begin;
+     std::size_t end;
+   };
+   struct Queue
+   {
+     std::mutex mutex;
+     std::deque<Range> ranges;
+   };
+
+   std::vector<std::unique_ptr<Queue>> m_queues;  // m_queues[0] belongs to the caller
+   std::vector<std::thread> m_workers;
+
+   std::mutex m_loopMutex;
+   const std::function<void(std::size_t, std::size_t)>* m_task = nullptr;
+   std::atomic<std::size_t> m_remaining{0};
+
+   std::mutex m_wakeMutex;
+   std::condition_variable m_wake;
+   std::condition_variable m_done;
+   unsigned long long m_generation = 0;
+   bool m_stop = false;
+
+   void workerLoop(unsigned int self);
+
+   // runs ranges until none is left in any queue
+   void runRanges(unsigned int self);
+
+   bool pop(unsigned int self, Range& range);
+   bool steal(unsigned int self, Range& range);
+};